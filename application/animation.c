@@ -0,0 +1,45 @@
+#include "animation.h"
+
+#include <stdlib.h>
+
+#include "window.h"
+
+bl_animation* bl_animation_new(bl_window *window,
+        int (*step)(bl_animation*, uint32_t, void*), void *user_data)
+{
+    bl_animation *animation = malloc(sizeof(bl_animation));
+
+    animation->window = window;
+    animation->step = step;
+    animation->user_data = user_data;
+
+    // Append to the window. The main loop picks it up on the next frame.
+    animation->prev = window->last_animation;
+    animation->next = NULL;
+    if (window->last_animation != NULL) {
+        window->last_animation->next = animation;
+    } else {
+        window->first_animation = animation;
+    }
+    window->last_animation = animation;
+
+    return animation;
+}
+
+void bl_animation_free(bl_animation *animation)
+{
+    bl_window *window = animation->window;
+
+    if (animation->prev != NULL) {
+        animation->prev->next = animation->next;
+    } else {
+        window->first_animation = animation->next;
+    }
+    if (animation->next != NULL) {
+        animation->next->prev = animation->prev;
+    } else {
+        window->last_animation = animation->prev;
+    }
+
+    free(animation);
+}
@@ -0,0 +1,31 @@
+#ifndef _BLUSHER_ANIMATION_H
+#define _BLUSHER_ANIMATION_H
+
+#include <stdint.h>
+
+typedef struct bl_window bl_window;
+
+/// \brief Per frame callback of a window.
+///
+/// step is called once per displayed frame with a CLOCK_MONOTONIC time in
+/// milliseconds. Return non-zero to keep running; the animation is freed
+/// after returning zero.
+typedef struct bl_animation {
+    /// \brief Siblings in the window animation list.
+    struct bl_animation *prev;
+    struct bl_animation *next;
+
+    bl_window *window;
+
+    int (*step)(struct bl_animation*, uint32_t time, void *user_data);
+    void *user_data;
+} bl_animation;
+
+/// \brief Start an animation. Frames are requested while any is running.
+bl_animation* bl_animation_new(bl_window *window,
+        int (*step)(bl_animation*, uint32_t, void*), void *user_data);
+
+/// \brief Stop and free the animation. Not for use from its own step.
+void bl_animation_free(bl_animation *animation);
+
+#endif /* _BLUSHER_ANIMATION_H */
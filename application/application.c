@@ -3,13 +3,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
 
 #include <linux/input.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
 
 #include "window.h"
 #include "surface.h"
 #include "pointer-event.h"
-#include <blusher-collections.h>
+#include "layout-cache.h"
+#include "fd-watch.h"
+#include "output.h"
+#include "presentation-stats.h"
+#include "keyboard.h"
 
 //==============
 // Seat
@@ -19,6 +29,7 @@
 static void keyboard_keymap_handler(void *data, struct wl_keyboard *keyboard,
         uint32_t format, int fd, uint32_t size)
 {
+    bl_keyboard_set_keymap(bl_app->keyboard_state, format, fd, size);
 }
 
 static void keyboard_enter_handler(void *data, struct wl_keyboard *keyboard,
@@ -36,7 +47,8 @@ static void keyboard_leave_handler(void *data, struct wl_keyboard *keyboard,
 static void keyboard_key_handler(void *data, struct wl_keyboard *keyboard,
         uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
 {
-    fprintf(stderr, "Key is %d, state is %d\n", key, state);
+    fprintf(stderr, "Key is %d, state is %d, text \"%s\"\n", key, state,
+        bl_keyboard_utf8(bl_app->keyboard_state, key));
 }
 
 static void keyboard_modifiers_handler(void *data, struct wl_keyboard *keyboard,
@@ -45,6 +57,13 @@ static void keyboard_modifiers_handler(void *data, struct wl_keyboard *keyboard,
 {
     fprintf(stderr, "Modifiers depressed %d, latched %d, locked %d, group %d\n",
         mods_depressed, mods_latched, mods_locked, group);
+    bl_keyboard_update_modifiers(bl_app->keyboard_state,
+        mods_depressed, mods_latched, mods_locked, group);
+}
+
+static void keyboard_repeat_info_handler(void *data,
+        struct wl_keyboard *keyboard, int32_t rate, int32_t delay)
+{
 }
 
 static const struct wl_keyboard_listener keyboard_listener = {
@@ -53,9 +72,121 @@ static const struct wl_keyboard_listener keyboard_listener = {
     .leave = keyboard_leave_handler,
     .key = keyboard_key_handler,
     .modifiers = keyboard_modifiers_handler,
+    .repeat_info = keyboard_repeat_info_handler,
 };
 
 // Pointer
+typedef void (*pointer_handler)(bl_surface*, const bl_pointer_event*);
+
+enum pointer_event_kind {
+    POINTER_MOVE,
+    POINTER_PRESS,
+    POINTER_RELEASE,
+};
+
+static pointer_handler get_pointer_handler(bl_surface *surface,
+        enum pointer_event_kind kind)
+{
+    switch (kind) {
+    case POINTER_MOVE:
+        return surface->pointer_move_event;
+    case POINTER_PRESS:
+        return surface->pointer_press_event;
+    case POINTER_RELEASE:
+        return surface->pointer_release_event;
+    }
+    return NULL;
+}
+
+/// \brief Deliver the event to the target or its nearest handling ancestor.
+///
+/// Events bubble up through flattened surfaces only. The surface owning the
+/// wl_surface is the last one tried.
+static void pointer_deliver(bl_surface *target, enum pointer_event_kind kind,
+        bl_pointer_event event)
+{
+    bl_surface *surface = target;
+    while (surface != NULL) {
+        pointer_handler handler = get_pointer_handler(surface, kind);
+        if (handler != NULL) {
+            handler(surface, &event);
+            return;
+        }
+        if (surface->surface != NULL) {
+            return;
+        }
+        event.x += surface->x;
+        event.y += surface->y;
+        surface = surface->parent;
+    }
+}
+
+/// \brief Dispatch pointer events accumulated since the last frame.
+///
+/// Multiple motion events in a frame are coalesced into the latest position.
+static void pointer_frame_dispatch(bl_application *application)
+{
+    bl_pointer_frame *frame = &(application->pointer_frame);
+
+    if (frame->mask & BL_POINTER_FRAME_MOTION) {
+        application->pointer_x = frame->x;
+        application->pointer_y = frame->y;
+    }
+
+    bl_surface *found = NULL;
+    if (application->pointer_surface != NULL) {
+        found = (bl_surface*)wl_surface_get_user_data(
+            application->pointer_surface);
+    }
+    if (found == NULL) {
+        frame->mask = 0;
+        return;
+    }
+
+    // Hit-test flattened descendants of the wl_surface owner.
+    double local_x;
+    double local_y;
+    bl_surface *target = bl_surface_pick(found,
+        wl_fixed_to_double(application->pointer_x),
+        wl_fixed_to_double(application->pointer_y),
+        &local_x, &local_y);
+
+    // Events live on the stack; handlers must not keep the pointer.
+    bl_pointer_event event = {
+        .serial = 0,
+        .button = 0,
+        .x = local_x,
+        .y = local_y,
+    };
+    // Pointer move event.
+    if (frame->mask & BL_POINTER_FRAME_MOTION) {
+        pointer_deliver(target, POINTER_MOVE, event);
+    }
+    if (frame->mask & BL_POINTER_FRAME_BUTTON) {
+        event.serial = frame->serial;
+        event.button = frame->button;
+        application->pointer_state = frame->state;
+        // Pointer press event.
+        if (frame->state == WL_POINTER_BUTTON_STATE_PRESSED) {
+            pointer_deliver(target, POINTER_PRESS, event);
+        }
+        // Pointer relesase event.
+        if (frame->state == WL_POINTER_BUTTON_STATE_RELEASED) {
+            pointer_deliver(target, POINTER_RELEASE, event);
+        }
+    }
+
+    frame->mask = 0;
+}
+
+/// \brief Dispatch immediately if the compositor never sends frame events.
+static void pointer_frame_dispatch_unframed(struct wl_pointer *pointer)
+{
+    if (wl_pointer_get_version(pointer) < WL_POINTER_FRAME_SINCE_VERSION) {
+        pointer_frame_dispatch(bl_app);
+    }
+}
+
 static void pointer_enter_handler(void *data, struct wl_pointer *pointer,
         uint32_t serial, struct wl_surface *surface,
         wl_fixed_t sx, wl_fixed_t sy)
@@ -63,8 +194,11 @@ static void pointer_enter_handler(void *data, struct wl_pointer *pointer,
     fprintf(stderr, "Pointer entered surface\t%p at %d %d\n", surface, sx, sy);
 
     bl_app->pointer_surface = surface;
-    bl_app->pointer_x = sx;
-    bl_app->pointer_y = sy;
+    bl_app->pointer_frame.mask |= BL_POINTER_FRAME_MOTION;
+    bl_app->pointer_frame.x = sx;
+    bl_app->pointer_frame.y = sy;
+
+    pointer_frame_dispatch_unframed(pointer);
 
     struct wl_buffer *buffer;
     struct wl_cursor_image *image;
@@ -87,48 +221,39 @@ static void pointer_leave_handler(void *data, struct wl_pointer *pointer,
         uint32_t serial, struct wl_surface *surface)
 {
     fprintf(stderr, "Pointer left surface\t%p\n", surface);
+
+    // Deliver what happened on the old surface before losing it.
+    pointer_frame_dispatch(bl_app);
+
+    if (bl_app->pointer_surface == surface) {
+        bl_app->pointer_surface = NULL;
+    }
 }
 
 static void pointer_motion_handler(void *data, struct wl_pointer *pointer,
         uint32_t time, wl_fixed_t sx, wl_fixed_t sy)
 {
-    bl_app->pointer_x = sx;
-    bl_app->pointer_y = sy;
-//    fprintf(stderr, "Pointer moved at %d %d\n", sx, sy);
-//    if (sx > 49152 && sy < 2816) {
-//        zxdg_surface_v6_destroy(xdg_surface);
-//    }
+    bl_app->pointer_frame.mask |= BL_POINTER_FRAME_MOTION;
+    bl_app->pointer_frame.x = sx;
+    bl_app->pointer_frame.y = sy;
+
+    pointer_frame_dispatch_unframed(pointer);
 }
 
 static void pointer_button_handler(void *data, struct wl_pointer *wl_pointer,
         uint32_t serial, uint32_t time, uint32_t button, uint32_t state)
 {
-    bl_app->pointer_state = state;
-
-    bl_surface *found = (bl_surface*)bl_ptr_btree_get(bl_app->surface_map,
-        (uint64_t)(bl_app->pointer_surface));
-    if (found != 0) {
-        // Pointer press event.
-        if (found->pointer_press_event != NULL &&
-                state == WL_POINTER_BUTTON_STATE_PRESSED) {
-            bl_pointer_event *event = bl_pointer_event_new();
-            event->serial = serial;
-            event->button = button;
-            event->x = bl_app->pointer_x / 256;
-            event->y = bl_app->pointer_y / 256;
-            found->pointer_press_event(found, event);
-        }
-        // Pointer relesase event.
-        if (found->pointer_release_event != NULL &&
-                state == WL_POINTER_BUTTON_STATE_RELEASED) {
-            bl_pointer_event *event = bl_pointer_event_new();
-            event->serial = serial;
-            event->button = button;
-            event->x = bl_app->pointer_x / 256;
-            event->y = bl_app->pointer_y / 256;
-            found->pointer_release_event(found, event);
-        }
+    // Only one button per frame is kept. Flush the previous one if any.
+    if (bl_app->pointer_frame.mask & BL_POINTER_FRAME_BUTTON) {
+        pointer_frame_dispatch(bl_app);
     }
+
+    bl_app->pointer_frame.mask |= BL_POINTER_FRAME_BUTTON;
+    bl_app->pointer_frame.serial = serial;
+    bl_app->pointer_frame.button = button;
+    bl_app->pointer_frame.state = state;
+
+    pointer_frame_dispatch_unframed(wl_pointer);
 }
 
 static void pointer_axis_handler(void *data, struct wl_pointer *wl_pointer,
@@ -137,12 +262,36 @@ static void pointer_axis_handler(void *data, struct wl_pointer *wl_pointer,
     fprintf(stderr, "Pointer handle axis\n");
 }
 
+static void pointer_frame_handler(void *data, struct wl_pointer *wl_pointer)
+{
+    pointer_frame_dispatch(bl_app);
+}
+
+static void pointer_axis_source_handler(void *data,
+        struct wl_pointer *wl_pointer, uint32_t axis_source)
+{
+}
+
+static void pointer_axis_stop_handler(void *data,
+        struct wl_pointer *wl_pointer, uint32_t time, uint32_t axis)
+{
+}
+
+static void pointer_axis_discrete_handler(void *data,
+        struct wl_pointer *wl_pointer, uint32_t axis, int32_t discrete)
+{
+}
+
 static const struct wl_pointer_listener pointer_listener = {
     .enter = pointer_enter_handler,
     .leave = pointer_leave_handler,
     .motion = pointer_motion_handler,
     .button = pointer_button_handler,
     .axis = pointer_axis_handler,
+    .frame = pointer_frame_handler,
+    .axis_source = pointer_axis_source_handler,
+    .axis_stop = pointer_axis_stop_handler,
+    .axis_discrete = pointer_axis_discrete_handler,
 };
 
 // Capabilities
@@ -177,8 +326,27 @@ static void seat_handle_capabilities(void *data, struct wl_seat *seat,
     }
 }
 
+static void seat_handle_name(void *data, struct wl_seat *seat,
+        const char *name)
+{
+}
+
 static const struct wl_seat_listener seat_listener = {
-    seat_handle_capabilities,
+    .capabilities = seat_handle_capabilities,
+    .name = seat_handle_name,
+};
+
+//==============
+// Xdg
+//==============
+static void xdg_wm_base_ping_handler(void *data,
+        struct xdg_wm_base *xdg_wm_base, uint32_t serial)
+{
+    xdg_wm_base_pong(xdg_wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener xdg_wm_base_listener = {
+    .ping = xdg_wm_base_ping_handler,
 };
 
 //=============
@@ -196,6 +364,39 @@ struct wl_shm_listener shm_listener = {
     .format = shm_format,
 };
 
+//================
+// Presentation
+//================
+static void presentation_clock_id_handler(void *data,
+        struct wp_presentation *presentation, uint32_t clk_id)
+{
+    bl_application *application = (bl_application*)data;
+    (void)presentation;
+
+    application->presentation_clock_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+    .clock_id = presentation_clock_id_handler,
+};
+
+static void report_signal_handler(bl_fd_watch *watch, uint32_t events,
+        void *user_data)
+{
+    bl_application *application = (bl_application*)user_data;
+    struct signalfd_siginfo info;
+    (void)events;
+
+    if (read(watch->fd, &info, sizeof(info)) != sizeof(info)) {
+        return;
+    }
+    for (bl_window *window = application->first_window; window != NULL;
+            window = window->next) {
+        fprintf(stderr, "Window \"%s\"\n", window->title);
+        bl_presentation_stats_report(window->presentation_stats, stderr);
+    }
+}
+
 //==============
 // Global
 //==============
@@ -203,12 +404,12 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
         uint32_t id, const char *interface, uint32_t version)
 {
     bl_application *application = (bl_application*)data;
-    (void)version;
 
     if (strcmp(interface, "wl_seat") == 0) {
         if (application->seat == NULL) {
+            // Version 5 for wl_pointer.frame.
             application->seat = wl_registry_bind(registry,
-                id, &wl_seat_interface, 1);
+                id, &wl_seat_interface, version < 5 ? version : 5);
             wl_seat_add_listener(application->seat,
                 &seat_listener, (void*)application);
         }
@@ -219,20 +420,12 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
         }
     } else if (strcmp(interface, "xdg_wm_base") == 0) {
         fprintf(stderr, "xdg_wm_base. version: %d.\n", version);
-        if (application->toplevel_windows_length >= 1) {
-            uint32_t len = application->toplevel_windows_length;
-            for (uint32_t i = 0; i < len; ++i) {
-                bl_window *window = application->toplevel_windows[i];
-                if (window->xdg_wm_base != NULL) {
-                    continue;
-                }
-                window->xdg_wm_base = wl_registry_bind(
-                    registry,
-                    id,
-                    &xdg_wm_base_interface,
-                    1
-                );
-            }
+        // Shared by all toplevel windows.
+        if (application->xdg_wm_base == NULL) {
+            application->xdg_wm_base = wl_registry_bind(registry,
+                id, &xdg_wm_base_interface, 1);
+            xdg_wm_base_add_listener(application->xdg_wm_base,
+                &xdg_wm_base_listener, NULL);
         }
     } else if (strcmp(interface, "wl_shm") == 0) {
         application->shm = wl_registry_bind(registry,
@@ -254,6 +447,30 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
             application->subcompositor = wl_registry_bind(registry,
                 id, &wl_subcompositor_interface, 1);
         }
+    } else if (strcmp(interface, "wl_output") == 0) {
+        bl_output_new(registry, id, version);
+    } else if (strcmp(interface, "wp_viewporter") == 0) {
+        if (application->viewporter == NULL) {
+            application->viewporter = wl_registry_bind(registry,
+                id, &wp_viewporter_interface, 1);
+        }
+    } else if (strcmp(interface, "wp_fractional_scale_manager_v1") == 0) {
+        if (application->fractional_scale_manager == NULL) {
+            application->fractional_scale_manager = wl_registry_bind(
+                registry, id, &wp_fractional_scale_manager_v1_interface, 1);
+        }
+    } else if (strcmp(interface, "wp_single_pixel_buffer_manager_v1") == 0) {
+        if (application->single_pixel_buffer_manager == NULL) {
+            application->single_pixel_buffer_manager = wl_registry_bind(
+                registry, id, &wp_single_pixel_buffer_manager_v1_interface, 1);
+        }
+    } else if (strcmp(interface, "wp_presentation") == 0) {
+        if (application->presentation == NULL) {
+            application->presentation = wl_registry_bind(registry,
+                id, &wp_presentation_interface, 1);
+            wp_presentation_add_listener(application->presentation,
+                &presentation_listener, (void*)application);
+        }
     } else {
         fprintf(stderr, "Interface <%s>\n", interface);
     }
@@ -262,10 +479,17 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
 static void global_registry_remover(void *data, struct wl_registry *registry,
         uint32_t id)
 {
-    (void)data;
+    bl_application *application = (bl_application*)data;
     (void)registry;
-    (void)id;
     fprintf(stderr, "global_registry_remover()\n");
+
+    for (bl_output *output = application->first_output; output != NULL;
+            output = output->next) {
+        if (output->id == id) {
+            bl_output_free(output);
+            break;
+        }
+    }
 }
 
 static const struct wl_registry_listener registry_listener = {
@@ -287,6 +511,23 @@ bl_application* bl_application_new()
         return NULL;
     }
     bl_application *application = malloc(sizeof(bl_application));
+    application->layout_cache = NULL;
+    application->xdg_wm_base = NULL;
+
+    application->first_window = NULL;
+    application->last_window = NULL;
+    application->toplevel_windows_length = 0;
+    application->first_output = NULL;
+
+    application->epoll_fd = -1;
+    application->dispatching = 0;
+    application->freed_watches = NULL;
+
+    // Checked by bl_application_free().
+    application->keyboard_state = NULL;
+    application->presentation = NULL;
+    application->report_signal_fd = -1;
+    application->report_watch = NULL;
 
     application->display = wl_display_connect(NULL);
     if (application->display == NULL) {
@@ -302,12 +543,23 @@ bl_application* bl_application_new()
 
     application->seat = NULL;
     application->keyboard = NULL;
+    application->keyboard_state = bl_keyboard_new();
     application->pointer = NULL;
 
-    application->toplevel_windows =
-        (bl_window**)malloc(sizeof(bl_window*) * 1); // Currently support only
-                                                     // one window.
-    application->toplevel_windows_length = 0;
+    application->viewporter = NULL;
+    application->fractional_scale_manager = NULL;
+    application->single_pixel_buffer_manager = NULL;
+    application->presentation_clock_id = CLOCK_MONOTONIC;
+    application->last_output = NULL;
+
+    application->pointer_surface = NULL;
+    application->pointer_x = 0;
+    application->pointer_y = 0;
+    application->pointer_state = WL_POINTER_BUTTON_STATE_RELEASED;
+    application->pointer_frame.mask = 0;
+
+    // Set singleton. Registry events already refer to it.
+    bl_app = application;
 
     application->registry = wl_display_get_registry(application->display);
     wl_registry_add_listener(application->registry,
@@ -316,45 +568,79 @@ bl_application* bl_application_new()
     wl_display_dispatch(application->display);
     wl_display_roundtrip(application->display);
 
-    application->surface_map = bl_ptr_btree_new();
-    application->pointer_surface = NULL;
+    application->layout_cache =
+        bl_layout_cache_new(BLUSHER_LAYOUT_CACHE_CAPACITY);
 
-    // Set singleton.
-    bl_app = application;
+    // Main loop. The display fd is registered with NULL data.
+    application->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event display_event = {
+        .events = EPOLLIN,
+        .data.ptr = NULL,
+    };
+    epoll_ctl(application->epoll_fd, EPOLL_CTL_ADD,
+        wl_display_get_fd(application->display), &display_event);
 
     return application;
 }
 
-void bl_application_add_window(bl_application *application, bl_window *window)
+void bl_application_enable_stats_signal(bl_application *application)
 {
-    application->toplevel_windows[0] = window;
-    application->toplevel_windows_length = 1;
+    if (application->report_signal_fd >= 0) {
+        return;
+    }
 
-    // Registry.
-    if (application->registry != NULL) {
-        wl_registry_destroy(application->registry);
+    // SIGUSR1 is read from the main loop instead of interrupting it.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    application->report_signal_fd = signalfd(-1, &mask,
+        SFD_NONBLOCK | SFD_CLOEXEC);
+    if (application->report_signal_fd >= 0) {
+        application->report_watch = bl_fd_watch_new(
+            application->report_signal_fd, EPOLLIN,
+            report_signal_handler, (void*)application);
     }
-    application->registry = wl_display_get_registry(application->display);
-    wl_registry_add_listener(application->registry,
-        &registry_listener, (void*)application);
+}
 
-    wl_display_dispatch(application->display);
+void bl_application_add_window(bl_application *application, bl_window *window)
+{
+    // Already added.
+    if (window->prev != NULL || application->first_window == window) {
+        return;
+    }
+
+    window->prev = application->last_window;
+    window->next = NULL;
+    if (application->last_window != NULL) {
+        application->last_window->next = window;
+    } else {
+        application->first_window = window;
+    }
+    application->last_window = window;
+    application->toplevel_windows_length += 1;
 }
 
 void bl_application_remove_window(bl_application *application,
         bl_window *window)
 {
-    uint32_t length = application->toplevel_windows_length;
-    bl_window *target = NULL;
-    for (uint32_t i = 0; i < length; ++i) {
-        if (application->toplevel_windows[i] == window) {
-            target = application->toplevel_windows[i];
-            application->toplevel_windows[i] = NULL;
-        }
+    if (window->prev != NULL) {
+        window->prev->next = window->next;
+    } else if (application->first_window == window) {
+        application->first_window = window->next;
+    } else {
+        // Not added.
+        bl_window_free(window);
+        return;
     }
-    if (target != NULL) {
-        application->toplevel_windows_length -= 1;
+    if (window->next != NULL) {
+        window->next->prev = window->prev;
+    } else {
+        application->last_window = window->prev;
     }
+    window->prev = NULL;
+    window->next = NULL;
+    application->toplevel_windows_length -= 1;
 
     bl_window_free(window);
 }
@@ -370,8 +656,91 @@ int bl_application_exec(bl_application *application)
         return 1;
     }
 
-    while (wl_display_dispatch(application->display) != -1) {
-        if (application->toplevel_windows_length == 0) {
+    struct wl_display *display = application->display;
+    struct epoll_event events[BLUSHER_MAX_EPOLL_EVENTS];
+    // Events the display fd is registered for.
+    uint32_t display_events = EPOLLIN;
+
+    while (application->toplevel_windows_length != 0) {
+        // Queued events must be dispatched before reading from the fd.
+        while (wl_display_prepare_read(display) != 0) {
+            wl_display_dispatch_pending(display);
+        }
+
+        // Re-layout and repaint what the dispatched events invalidated.
+        for (bl_window *window = application->first_window; window != NULL;
+                window = window->next) {
+            bl_window_update(window);
+        }
+
+        // One flush for all requests of this iteration. If the socket is
+        // full, wait until it is writable to flush the rest, otherwise
+        // the requests stall until an unrelated event wakes us up.
+        uint32_t wanted_events = EPOLLIN;
+        if (wl_display_flush(display) < 0) {
+            if (errno != EAGAIN) {
+                wl_display_cancel_read(display);
+                break;
+            }
+            wanted_events |= EPOLLOUT;
+        }
+        if (wanted_events != display_events) {
+            struct epoll_event display_event = {
+                .events = wanted_events,
+                .data.ptr = NULL,
+            };
+            epoll_ctl(application->epoll_fd, EPOLL_CTL_MOD,
+                wl_display_get_fd(display), &display_event);
+            display_events = wanted_events;
+        }
+
+        int n = epoll_wait(application->epoll_fd, events,
+            BLUSHER_MAX_EPOLL_EVENTS, -1);
+        if (n < 0) {
+            wl_display_cancel_read(display);
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        int display_ready = 0;
+        for (int i = 0; i < n; ++i) {
+            // Writable alone is handled by the flush above.
+            if (events[i].data.ptr == NULL &&
+                    (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+                display_ready = 1;
+            }
+        }
+
+        // Events of this batch may point to watches freed by any handler
+        // below, Wayland ones included. Release them after the batch.
+        application->dispatching = 1;
+        int failed = 0;
+        if (display_ready) {
+            failed = wl_display_read_events(display) < 0;
+        } else {
+            wl_display_cancel_read(display);
+        }
+        if (!failed) {
+            failed = wl_display_dispatch_pending(display) < 0;
+        }
+
+        // User fd watches and timers.
+        for (int i = 0; i < n && !failed; ++i) {
+            bl_fd_watch *watch = (bl_fd_watch*)events[i].data.ptr;
+            if (watch != NULL && watch->callback != NULL) {
+                watch->callback(watch, events[i].events, watch->user_data);
+            }
+        }
+        application->dispatching = 0;
+
+        while (application->freed_watches != NULL) {
+            bl_fd_watch *watch = application->freed_watches;
+            application->freed_watches = watch->next_freed;
+            free(watch);
+        }
+        if (failed) {
             break;
         }
     }
@@ -381,7 +750,33 @@ int bl_application_exec(bl_application *application)
 
 void bl_application_free(bl_application *application)
 {
-    bl_ptr_btree_free(application->surface_map);
+    while (application->first_window != NULL) {
+        bl_application_remove_window(application, application->first_window);
+    }
+    if (application->xdg_wm_base != NULL) {
+        xdg_wm_base_destroy(application->xdg_wm_base);
+    }
+    while (application->first_output != NULL) {
+        bl_output_free(application->first_output);
+    }
+    if (application->layout_cache != NULL) {
+        bl_layout_cache_free(application->layout_cache);
+    }
+    if (application->keyboard_state != NULL) {
+        bl_keyboard_free(application->keyboard_state);
+    }
+    if (application->report_watch != NULL) {
+        bl_fd_watch_free(application->report_watch);
+    }
+    if (application->report_signal_fd >= 0) {
+        close(application->report_signal_fd);
+    }
+    if (application->presentation != NULL) {
+        wp_presentation_destroy(application->presentation);
+    }
+    if (application->epoll_fd >= 0) {
+        close(application->epoll_fd);
+    }
     free(application);
     application = NULL;
 }
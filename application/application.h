@@ -2,11 +2,37 @@
 #define _BLUSHER_APPLICATION_H
 
 #include <stdint.h>
+#include <time.h>
 
 #include <wayland-client.h>
 
+#include <stable/xdg-shell.h>
+#include <stable/viewporter.h>
+#include <staging/fractional-scale-v1.h>
+#include <staging/single-pixel-buffer-v1.h>
+#include <stable/presentation-time.h>
+
 typedef struct bl_window bl_window;
-typedef struct bl_ptr_btree bl_ptr_btree;
+typedef struct bl_layout_cache bl_layout_cache;
+typedef struct bl_fd_watch bl_fd_watch;
+typedef struct bl_output bl_output;
+typedef struct bl_keyboard bl_keyboard;
+
+#define BLUSHER_MAX_EPOLL_EVENTS 16
+
+#define BL_POINTER_FRAME_MOTION (1 << 0)
+#define BL_POINTER_FRAME_BUTTON (1 << 1)
+
+/// \brief Pointer events pending until the next wl_pointer.frame.
+typedef struct bl_pointer_frame {
+    /// \brief Bitwise OR of BL_POINTER_FRAME_* flags.
+    uint32_t mask;
+    wl_fixed_t x;
+    wl_fixed_t y;
+    uint32_t serial;
+    uint32_t button;
+    uint32_t state;
+} bl_pointer_frame;
 
 typedef struct bl_application {
     struct wl_display *display;
@@ -17,13 +43,31 @@ typedef struct bl_application {
 
     struct wl_seat *seat;
     struct wl_keyboard *keyboard;
+    /// \brief Keymap and key translation of the keyboard.
+    bl_keyboard *keyboard_state;
     struct wl_pointer *pointer;
 
-    bl_window **toplevel_windows;
+    struct xdg_wm_base *xdg_wm_base;
+    /// \brief NULL if the compositor does not support it.
+    struct wp_viewporter *viewporter;
+    /// \brief NULL if the compositor does not support it.
+    struct wp_fractional_scale_manager_v1 *fractional_scale_manager;
+    /// \brief NULL if the compositor does not support it.
+    struct wp_single_pixel_buffer_manager_v1 *single_pixel_buffer_manager;
+    /// \brief NULL if the compositor does not support it.
+    struct wp_presentation *presentation;
+    /// \brief Clock of presentation timestamps.
+    clockid_t presentation_clock_id;
+
+    bl_output *first_output;
+    bl_output *last_output;
+
+    /// \brief Toplevel windows in a doubly linked list through
+    /// bl_window::prev and bl_window::next.
+    bl_window *first_window;
+    bl_window *last_window;
     uint32_t toplevel_windows_length;
 
-    /// \brief Structure that map wl_surface to bl_surface.
-    bl_ptr_btree *surface_map;
     struct wl_surface *pointer_surface;
     /// \brief Store surface local x because press event not have x.
     int32_t pointer_x;
@@ -31,17 +75,43 @@ typedef struct bl_application {
     int32_t pointer_y;
     /// \brief Store pointer state when pressed or released.
     uint32_t pointer_state;
+    bl_pointer_frame pointer_frame;
+
+    /// \brief Shaped text layouts shared by all labels.
+    bl_layout_cache *layout_cache;
+
+    /// \brief Main loop epoll instance for the display fd, fd watches
+    /// and timers.
+    int epoll_fd;
+    /// \brief Set while fd watch callbacks run.
+    int dispatching;
+    /// \brief Watches freed during dispatch, released after it.
+    bl_fd_watch *freed_watches;
+
+    /// \brief signalfd for SIGUSR1, which prints presentation stats.
+    /// -1 unless enabled with bl_application_enable_stats_signal().
+    int report_signal_fd;
+    bl_fd_watch *report_watch;
 } bl_application;
 
 extern bl_application *bl_app;  // Singleton object.
 
 bl_application* bl_application_new();
 
+/// \brief Print presentation stats of all windows on SIGUSR1.
+///
+/// Blocks SIGUSR1 in the calling thread and reads it from the main loop.
+/// Call before starting other threads, they inherit the mask.
+void bl_application_enable_stats_signal(bl_application *application);
+
 void bl_application_add_window(bl_application *application, bl_window *window);
 
 void bl_application_remove_window(bl_application *application,
         bl_window *window);
 
+/// \brief Run the main loop until all windows are removed.
+///
+/// Waits on the display fd, fd watches and timers with epoll.
 int bl_application_exec(bl_application *application);
 
 void bl_application_free(bl_application *application);
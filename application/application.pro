@@ -6,7 +6,13 @@ SOURCES += main.c \
     title-bar.c \
     color.c \
     label.c \
-    pointer-event.c
+    layout-cache.c \
+    fd-watch.c \
+    timer.c \
+    animation.c \
+    output.c \
+    presentation-stats.c \
+    keyboard.c
 
 HEADERS += utils.h \
     application.h \
@@ -15,10 +21,16 @@ HEADERS += utils.h \
     title-bar.h \
     color.h \
     label.h \
-    pointer-event.h \
-    blusher-collections/include/blusher-collections.h
+    layout-cache.h \
+    fd-watch.h \
+    timer.h \
+    animation.h \
+    output.h \
+    presentation-stats.h \
+    keyboard.h \
+    pointer-event.h
 
-INCLUDEPATH += wayland-protocols blusher-collections/include \
+INCLUDEPATH += wayland-protocols \
     /usr/include/pango-1.0 \
     /usr/include/glib-2.0 \
     /usr/lib/glib-2.0/include \
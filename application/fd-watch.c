@@ -0,0 +1,47 @@
+#include "fd-watch.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "application.h"
+
+bl_fd_watch* bl_fd_watch_new(int fd, uint32_t events,
+        bl_fd_watch_callback callback, void *user_data)
+{
+    bl_fd_watch *watch = malloc(sizeof(bl_fd_watch));
+
+    watch->fd = fd;
+    watch->events = events;
+    watch->callback = callback;
+    watch->user_data = user_data;
+    watch->next_freed = NULL;
+
+    struct epoll_event event = {
+        .events = events,
+        .data.ptr = watch,
+    };
+    if (epoll_ctl(bl_app->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        fprintf(stderr, "bl_fd_watch_new() - epoll_ctl failed: %m\n");
+        free(watch);
+
+        return NULL;
+    }
+
+    return watch;
+}
+
+void bl_fd_watch_free(bl_fd_watch *watch)
+{
+    epoll_ctl(bl_app->epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL);
+
+    // Pending epoll events may still point to this watch. Release it after
+    // the current dispatch.
+    if (bl_app->dispatching) {
+        watch->callback = NULL;
+        watch->next_freed = bl_app->freed_watches;
+        bl_app->freed_watches = watch;
+        return;
+    }
+
+    free(watch);
+}
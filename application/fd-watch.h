@@ -0,0 +1,35 @@
+#ifndef _BLUSHER_FD_WATCH_H
+#define _BLUSHER_FD_WATCH_H
+
+#include <stdint.h>
+
+#include <sys/epoll.h>
+
+typedef struct bl_fd_watch bl_fd_watch;
+
+/// \brief Called from bl_application_exec() when the fd is ready.
+///
+/// events is the bitwise OR of EPOLL* flags reported by epoll_wait.
+typedef void (*bl_fd_watch_callback)(bl_fd_watch*, uint32_t events,
+        void *user_data);
+
+typedef struct bl_fd_watch {
+    int fd;
+    uint32_t events;
+    bl_fd_watch_callback callback;
+    void *user_data;
+
+    /// \brief Next watch freed during dispatch.
+    struct bl_fd_watch *next_freed;
+} bl_fd_watch;
+
+/// \brief Watch fd for events (EPOLLIN, EPOLLOUT, ...) in the main loop.
+///
+/// The fd is not owned by the watch and is not closed on free.
+bl_fd_watch* bl_fd_watch_new(int fd, uint32_t events,
+        bl_fd_watch_callback callback, void *user_data);
+
+/// \brief Stop watching. Safe to call from any watch callback.
+void bl_fd_watch_free(bl_fd_watch *watch);
+
+#endif /* _BLUSHER_FD_WATCH_H */
@@ -0,0 +1,198 @@
+#include "keyboard.h"
+
+// Std libs
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Unix
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <wayland-client.h>
+
+// FNV-1a. Only has to tell keymaps apart, together with the size.
+static uint64_t hash_keymap(const char *data, uint32_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (uint32_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static void clear_table(bl_keyboard *keyboard)
+{
+    for (uint32_t i = 0; i < BLUSHER_KEYBOARD_TABLE_SIZE; ++i) {
+        keyboard->table[i].filled = 0;
+    }
+}
+
+static struct xkb_keymap* find_keymap(bl_keyboard *keyboard, uint64_t hash,
+        uint32_t size)
+{
+    for (uint32_t i = 0; i < keyboard->cache_length; ++i) {
+        bl_keymap_entry *entry = &keyboard->cache[i];
+        if (entry->hash == hash && entry->size == size) {
+            return entry->keymap;
+        }
+    }
+
+    return NULL;
+}
+
+static void insert_keymap(bl_keyboard *keyboard, uint64_t hash,
+        uint32_t size, struct xkb_keymap *keymap)
+{
+    bl_keymap_entry *entry;
+
+    if (keyboard->cache_length < BLUSHER_KEYMAP_CACHE_SIZE) {
+        entry = &keyboard->cache[keyboard->cache_length];
+        keyboard->cache_length += 1;
+    } else {
+        // The current keymap is never evicted.
+        entry = &keyboard->cache[keyboard->cache_next];
+        if (entry->keymap == keyboard->keymap) {
+            keyboard->cache_next =
+                (keyboard->cache_next + 1) % BLUSHER_KEYMAP_CACHE_SIZE;
+            entry = &keyboard->cache[keyboard->cache_next];
+        }
+        xkb_keymap_unref(entry->keymap);
+        keyboard->cache_next =
+            (keyboard->cache_next + 1) % BLUSHER_KEYMAP_CACHE_SIZE;
+    }
+    entry->hash = hash;
+    entry->size = size;
+    entry->keymap = keymap;
+}
+
+static bl_key_lookup* lookup(bl_keyboard *keyboard, uint32_t key)
+{
+    static bl_key_lookup none = { XKB_KEY_NoSymbol, "", 1 };
+
+    if (keyboard->state == NULL) {
+        return &none;
+    }
+
+    bl_key_lookup *entry;
+    if (key < BLUSHER_KEYBOARD_TABLE_SIZE) {
+        entry = &keyboard->table[key];
+        if (entry->filled) {
+            return entry;
+        }
+        entry->filled = 1;
+    } else {
+        // Rare keys past the table are translated on every call.
+        entry = &keyboard->uncached;
+    }
+
+    // Evdev keycodes are offset by 8 in XKB.
+    xkb_keycode_t keycode = key + 8;
+    entry->keysym = xkb_state_key_get_one_sym(keyboard->state, keycode);
+    xkb_state_key_get_utf8(keyboard->state, keycode,
+        entry->utf8, sizeof(entry->utf8));
+
+    return entry;
+}
+
+//=============
+// Keyboard
+//=============
+
+bl_keyboard* bl_keyboard_new()
+{
+    bl_keyboard *keyboard = malloc(sizeof(bl_keyboard));
+
+    keyboard->context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    keyboard->cache_length = 0;
+    keyboard->cache_next = 0;
+    keyboard->keymap = NULL;
+    keyboard->state = NULL;
+    clear_table(keyboard);
+
+    return keyboard;
+}
+
+int bl_keyboard_set_keymap(bl_keyboard *keyboard, uint32_t format, int fd,
+        uint32_t size)
+{
+    if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1 || size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "bl_keyboard_set_keymap() - mmap failed.\n");
+        return 0;
+    }
+
+    // The string is NUL terminated, which is included in size.
+    uint64_t hash = hash_keymap(data, size);
+    struct xkb_keymap *keymap = find_keymap(keyboard, hash, size);
+    if (keymap == NULL) {
+        keymap = xkb_keymap_new_from_string(keyboard->context, data,
+            XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
+        if (keymap == NULL) {
+            fprintf(stderr, "bl_keyboard_set_keymap() - compile failed.\n");
+            munmap(data, size);
+            return 0;
+        }
+        insert_keymap(keyboard, hash, size, keymap);
+    }
+    munmap(data, size);
+
+    if (keymap == keyboard->keymap) {
+        return 1;
+    }
+    if (keyboard->state != NULL) {
+        xkb_state_unref(keyboard->state);
+    }
+    keyboard->keymap = keymap;
+    keyboard->state = xkb_state_new(keymap);
+    clear_table(keyboard);
+
+    return 1;
+}
+
+void bl_keyboard_update_modifiers(bl_keyboard *keyboard,
+        uint32_t depressed, uint32_t latched, uint32_t locked,
+        uint32_t group)
+{
+    if (keyboard->state == NULL) {
+        return;
+    }
+
+    enum xkb_state_component changed = xkb_state_update_mask(
+        keyboard->state, depressed, latched, locked, 0, 0, group);
+    if (changed != 0) {
+        clear_table(keyboard);
+    }
+}
+
+xkb_keysym_t bl_keyboard_keysym(bl_keyboard *keyboard, uint32_t key)
+{
+    return lookup(keyboard, key)->keysym;
+}
+
+const char* bl_keyboard_utf8(bl_keyboard *keyboard, uint32_t key)
+{
+    return lookup(keyboard, key)->utf8;
+}
+
+void bl_keyboard_free(bl_keyboard *keyboard)
+{
+    if (keyboard->state != NULL) {
+        xkb_state_unref(keyboard->state);
+    }
+    for (uint32_t i = 0; i < keyboard->cache_length; ++i) {
+        xkb_keymap_unref(keyboard->cache[i].keymap);
+    }
+    xkb_context_unref(keyboard->context);
+
+    free(keyboard);
+}
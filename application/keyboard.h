@@ -0,0 +1,71 @@
+#ifndef _BLUSHER_KEYBOARD_H
+#define _BLUSHER_KEYBOARD_H
+
+#include <stdint.h>
+
+#include <xkbcommon/xkbcommon.h>
+
+#define BLUSHER_KEYMAP_CACHE_SIZE 4
+/// \brief Keycodes with a lookup table entry. Covers the common keys,
+/// higher keycodes are translated on every lookup.
+#define BLUSHER_KEYBOARD_TABLE_SIZE 256
+
+/// \brief Compiled keymap and the hash of its source text.
+typedef struct bl_keymap_entry {
+    uint64_t hash;
+    uint32_t size;
+    struct xkb_keymap *keymap;
+} bl_keymap_entry;
+
+/// \brief Translated key for the current modifiers.
+typedef struct bl_key_lookup {
+    xkb_keysym_t keysym;
+    /// \brief NUL terminated UTF-8. Empty if the key has no text.
+    char utf8[8];
+    int filled;
+} bl_key_lookup;
+
+typedef struct bl_keyboard {
+    struct xkb_context *context;
+    /// \brief Keymaps by content hash. The compositor re-sends the same
+    /// keymap on reconnect and seat changes, which then compiles once.
+    bl_keymap_entry cache[BLUSHER_KEYMAP_CACHE_SIZE];
+    uint32_t cache_length;
+    /// \brief Next entry to evict when the cache is full.
+    uint32_t cache_next;
+
+    /// \brief Current keymap, owned by the cache. NULL before keymap event.
+    struct xkb_keymap *keymap;
+    struct xkb_state *state;
+
+    /// \brief Filled lazily, cleared when the keymap or modifiers change.
+    bl_key_lookup table[BLUSHER_KEYBOARD_TABLE_SIZE];
+    /// \brief Last lookup of a keycode past the table.
+    bl_key_lookup uncached;
+} bl_keyboard;
+
+bl_keyboard* bl_keyboard_new();
+
+/// \brief Use the keymap from wl_keyboard.keymap. Takes ownership of fd.
+///
+/// Returns 0 on failure, the previous keymap is kept then.
+int bl_keyboard_set_keymap(bl_keyboard *keyboard, uint32_t format, int fd,
+        uint32_t size);
+
+/// \brief Apply wl_keyboard.modifiers.
+void bl_keyboard_update_modifiers(bl_keyboard *keyboard,
+        uint32_t depressed, uint32_t latched, uint32_t locked,
+        uint32_t group);
+
+/// \brief Keysym of an evdev key from wl_keyboard.key.
+xkb_keysym_t bl_keyboard_keysym(bl_keyboard *keyboard, uint32_t key);
+
+/// \brief UTF-8 text of an evdev key. Empty string if none.
+///
+/// Valid until the keymap or modifiers change, or for keycodes past the
+/// table, until the next lookup.
+const char* bl_keyboard_utf8(bl_keyboard *keyboard, uint32_t key);
+
+void bl_keyboard_free(bl_keyboard *keyboard);
+
+#endif /* _BLUSHER_KEYBOARD_H */
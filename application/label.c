@@ -8,52 +8,83 @@
 #include <pango/pangocairo.h>
 
 // Blusher
-#include "utils.h"
+#include "application.h"
+#include "layout-cache.h"
 
 //=================
 // Cairo / Pango
 //=================
-static void draw_text(bl_label *label,
-        cairo_surface_t *cairo_surface, cairo_t *cr)
+static void draw_text(bl_label *label, cairo_t *cr)
 {
-    PangoLayout *layout;
-    PangoFontDescription *desc;
-
-    layout = pango_cairo_create_layout(cr);
-
-    pango_layout_set_text(layout, label->text, -1);
-
-    desc = pango_font_description_from_string("serif");
-    pango_font_description_set_size(desc,
-        pixel_to_pango_size(label->font_size));
-
-    pango_layout_set_font_description(layout, desc);
-    pango_font_description_free(desc);
+    PangoLayout *layout = bl_layout_cache_get(bl_app->layout_cache,
+        label->font_family, label->font_size, label->text);
 
     cairo_save(cr);
 
-    cairo_set_source_rgb(cr, 1.0, 0.0, 0.0);
+    // Clear previous contents of an own buffer. A flattened label draws
+    // over the freshly painted parent instead.
+    if (label->surface->surface != NULL) {
+        cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+        cairo_paint(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    }
 
-    pango_cairo_update_layout(cr, layout);
+    cairo_set_source_rgba(cr,
+        label->font_color.red / 255.0,
+        label->font_color.green / 255.0,
+        label->font_color.blue / 255.0,
+        label->font_color.alpha / 255.0);
 
-    // pango_layout_get_size(layout, &width, &height);
     cairo_move_to(cr, 0, 0);
     pango_cairo_show_layout(cr, layout);
 
     cairo_restore(cr);
+}
 
-    g_object_unref(layout);
+//=================
+// Surface hooks
+//=================
+static void label_measure(bl_surface *surface, double *width, double *height)
+{
+    bl_label *label = (bl_label*)surface->user_data;
+
+    PangoLayout *layout = bl_layout_cache_get(bl_app->layout_cache,
+        label->font_family, label->font_size, label->text);
 
-    // Copy cairo data to the shm_data.
-    int width = label->surface->width;
-    int height = label->surface->height;
-    int stride = width * 4;
-    int size= stride * height;
+    int pixel_width;
+    int pixel_height;
+    pango_layout_get_pixel_size(layout, &pixel_width, &pixel_height);
+
+    *width = pixel_width;
+    *height = pixel_height;
+}
 
-    unsigned char *data = cairo_image_surface_get_data(cairo_surface);
-    for (int i = 0; i < size; ++i) {
-        ((unsigned char*)(label->surface->shm_data))[i] = data[i];
+static void label_paint(bl_surface *surface)
+{
+    bl_label *label = (bl_label*)surface->user_data;
+
+    if (surface->cairo_surface == NULL) {
+        return;
     }
+
+    // Draw directly into the shm buffer.
+    cairo_t *cr = cairo_create(surface->cairo_surface);
+
+    draw_text(label, cr);
+
+    cairo_destroy(cr);
+    cairo_surface_flush(surface->cairo_surface);
+}
+
+/// \brief Resize the surface to fit the text.
+static void fit_to_text(bl_label *label)
+{
+    double width;
+    double height;
+
+    bl_surface_measure(label->surface, &width, &height);
+    bl_surface_set_geometry(label->surface,
+        label->surface->x, label->surface->y, width, height);
 }
 
 //==============
@@ -64,31 +95,37 @@ bl_label* bl_label_new(bl_surface *parent, const char *text)
     bl_label *label = malloc(sizeof(bl_label));
 
     label->surface = bl_surface_new(parent);
+    label->surface->user_data = label;
+    label->surface->measure = label_measure;
+    label->surface->paint = label_paint;
 
     label->text = malloc(sizeof(char) * strlen(text) + 1);
     strncpy(label->text, text, strlen(text));
     label->text[strlen(text)] = '\0';
+    label->font_family = "serif";
     label->font_size = 13;
     label->font_color = bl_color_from_rgb(0, 0, 0);
 
     return label;
 }
 
-void bl_label_show(bl_label *label)
+void bl_label_set_text(bl_label *label, const char *text)
 {
-    bl_surface_set_geometry(label->surface, 0, 0, 100, 50);
-
-    cairo_surface_t *cairo_surface = cairo_image_surface_create(
-        CAIRO_FORMAT_ARGB32, label->surface->width, label->surface->height);
-    cairo_t *cr = cairo_create(cairo_surface);
+    free(label->text);
+    label->text = malloc(sizeof(char) * strlen(text) + 1);
+    strncpy(label->text, text, strlen(text));
+    label->text[strlen(text)] = '\0';
 
-    draw_text(label, cairo_surface, cr);
+    // Only this label and the path to the root are visited on next update.
+    fit_to_text(label);
+    bl_surface_invalidate(label->surface);
+}
 
-//    bl_surface_show(label->surface);
-    wl_surface_attach(label->surface->surface, label->surface->buffer, 0, 0);
-    wl_surface_commit(label->surface->surface);
+void bl_label_show(bl_label *label)
+{
+    fit_to_text(label);
 
-    wl_surface_commit(label->surface->parent->surface);
+    bl_surface_show(label->surface);
 }
 
 void bl_label_free(bl_label *label)
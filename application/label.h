@@ -8,12 +8,16 @@ typedef struct bl_label {
     bl_surface *surface;
 
     char *text;
+    const char *font_family;
     double font_size;
     bl_color font_color;
 } bl_label;
 
 bl_label* bl_label_new(bl_surface *parent, const char *text);
 
+/// \brief Change the text. Repainted on the next update.
+void bl_label_set_text(bl_label *label, const char *text);
+
 void bl_label_show(bl_label *label);
 
 void bl_label_free(bl_label* label);
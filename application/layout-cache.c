@@ -0,0 +1,105 @@
+#include "layout-cache.h"
+
+// Std libs
+#include <stdlib.h>
+
+// Pango
+#include <pango/pangocairo.h>
+
+// Blusher
+#include "utils.h"
+
+typedef struct bl_layout_cache_entry {
+    char *key;
+    PangoLayout *layout;
+    GList *link;
+} bl_layout_cache_entry;
+
+static void entry_free(void *data)
+{
+    bl_layout_cache_entry *entry = (bl_layout_cache_entry*)data;
+
+    g_object_unref(entry->layout);
+    g_free(entry->key);
+    free(entry);
+}
+
+static PangoLayout* create_layout(bl_layout_cache *cache,
+        const char *font_family, double font_size, const char *text)
+{
+    PangoLayout *layout = pango_layout_new(cache->context);
+    PangoFontDescription *desc;
+
+    pango_layout_set_text(layout, text, -1);
+
+    desc = pango_font_description_from_string(font_family);
+    pango_font_description_set_size(desc, pixel_to_pango_size(font_size));
+
+    pango_layout_set_font_description(layout, desc);
+    pango_font_description_free(desc);
+
+    return layout;
+}
+
+//=================
+// Layout Cache
+//=================
+bl_layout_cache* bl_layout_cache_new(uint32_t capacity)
+{
+    bl_layout_cache *cache = malloc(sizeof(bl_layout_cache));
+
+    // All layouts share one context so shaping results can be reused
+    // across cairo contexts.
+    cache->context = pango_font_map_create_context(
+        pango_cairo_font_map_get_default());
+    cache->table = g_hash_table_new_full(g_str_hash, g_str_equal,
+        NULL, entry_free);
+    cache->lru = g_queue_new();
+    cache->capacity = capacity;
+
+    return cache;
+}
+
+PangoLayout* bl_layout_cache_get(bl_layout_cache *cache,
+        const char *font_family, double font_size, const char *text)
+{
+    char *key = g_strdup_printf("%s\x1f%g\x1f%s",
+        font_family, font_size, text);
+
+    bl_layout_cache_entry *entry = g_hash_table_lookup(cache->table, key);
+    if (entry != NULL) {
+        g_free(key);
+        // Move to the most recently used position.
+        g_queue_unlink(cache->lru, entry->link);
+        g_queue_push_head_link(cache->lru, entry->link);
+
+        return entry->layout;
+    }
+
+    // Evict the least recently used layout.
+    if (g_hash_table_size(cache->table) >= cache->capacity) {
+        GList *tail = g_queue_pop_tail_link(cache->lru);
+        bl_layout_cache_entry *evicted = (bl_layout_cache_entry*)tail->data;
+        g_list_free_1(tail);
+        g_hash_table_remove(cache->table, evicted->key);
+    }
+
+    entry = malloc(sizeof(bl_layout_cache_entry));
+    entry->key = key;
+    entry->layout = create_layout(cache, font_family, font_size, text);
+    entry->link = g_list_alloc();
+    entry->link->data = entry;
+    g_queue_push_head_link(cache->lru, entry->link);
+    g_hash_table_insert(cache->table, entry->key, entry);
+
+    return entry->layout;
+}
+
+void bl_layout_cache_free(bl_layout_cache *cache)
+{
+    g_queue_free(cache->lru);
+    g_hash_table_destroy(cache->table);
+    g_object_unref(cache->context);
+
+    free(cache);
+}
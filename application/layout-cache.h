@@ -0,0 +1,30 @@
+#ifndef _BLUSHER_LAYOUT_CACHE_H
+#define _BLUSHER_LAYOUT_CACHE_H
+
+#include <stdint.h>
+
+#include <pango/pango.h>
+
+#define BLUSHER_LAYOUT_CACHE_CAPACITY 256
+
+/// \brief Cache of shaped Pango layouts keyed by font, size and text.
+///
+/// Least recently used layouts are dropped when the capacity is exceeded.
+typedef struct bl_layout_cache {
+    PangoContext *context;
+    GHashTable *table;
+    GQueue *lru;
+    uint32_t capacity;
+} bl_layout_cache;
+
+bl_layout_cache* bl_layout_cache_new(uint32_t capacity);
+
+/// \brief Get a layout for the text, shaping it only on a cache miss.
+///
+/// The layout is owned by the cache and may be evicted by a later call.
+PangoLayout* bl_layout_cache_get(bl_layout_cache *cache,
+        const char *font_family, double font_size, const char *text);
+
+void bl_layout_cache_free(bl_layout_cache *cache);
+
+#endif /* _BLUSHER_LAYOUT_CACHE_H */
@@ -297,7 +297,7 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
 // Surface events
 //==================
 static void rect_pointer_press_handler(bl_surface *surface,
-        bl_pointer_event *event)
+        const bl_pointer_event *event)
 {
     fprintf(stderr, "Rect pressed!\n");
     bl_surface_set_geometry(
@@ -316,14 +316,15 @@ static void rect_pointer_press_handler(bl_surface *surface,
 int main(int argc, char *argv[])
 {
     bl_application *app = bl_application_new();
+    bl_application_enable_stats_signal(app);
 
     bl_window *window = bl_window_new();
     bl_application_add_window(app, window);
 
     bl_window_show(window);
 
-    bl_surface *rect = bl_surface_new(window->surface);
-    wl_surface_set_buffer_scale(rect->surface, 2);
+    // Moves on every press, so give it its own wl_subsurface.
+    bl_surface *rect = bl_surface_new_subsurface(window->surface);
     bl_surface_set_geometry(rect, 10, 10, 100, 100);
     rect->pointer_press_event = rect_pointer_press_handler;
     bl_surface_show(rect);
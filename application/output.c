@@ -0,0 +1,103 @@
+#include "output.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "application.h"
+#include "window.h"
+#include "surface.h"
+
+//=============
+// Output
+//=============
+static void output_geometry_handler(void *data, struct wl_output *wl_output,
+        int32_t x, int32_t y, int32_t physical_width, int32_t physical_height,
+        int32_t subpixel, const char *make, const char *model,
+        int32_t transform)
+{
+}
+
+static void output_mode_handler(void *data, struct wl_output *wl_output,
+        uint32_t flags, int32_t width, int32_t height, int32_t refresh)
+{
+}
+
+static void output_done_handler(void *data, struct wl_output *wl_output)
+{
+    bl_output *output = (bl_output*)data;
+
+    if (output->scale == output->pending_scale) {
+        return;
+    }
+    output->scale = output->pending_scale;
+
+    // Surfaces on this output may need a buffer of another scale.
+    for (bl_window *window = bl_app->first_window; window != NULL;
+            window = window->next) {
+        bl_surface_refresh_scale(window->surface);
+    }
+}
+
+static void output_scale_handler(void *data, struct wl_output *wl_output,
+        int32_t factor)
+{
+    bl_output *output = (bl_output*)data;
+
+    fprintf(stderr, "Output scale: %d\n", factor);
+    output->pending_scale = factor;
+}
+
+static const struct wl_output_listener output_listener = {
+    .geometry = output_geometry_handler,
+    .mode = output_mode_handler,
+    .done = output_done_handler,
+    .scale = output_scale_handler,
+};
+
+bl_output* bl_output_new(struct wl_registry *registry, uint32_t id,
+        uint32_t version)
+{
+    bl_output *output = malloc(sizeof(bl_output));
+
+    // Version 2 for scale and done events.
+    output->output = wl_registry_bind(registry, id, &wl_output_interface,
+        version < 2 ? version : 2);
+    output->id = id;
+    output->scale = 1;
+    output->pending_scale = 1;
+    wl_output_add_listener(output->output, &output_listener, output);
+
+    output->prev = bl_app->last_output;
+    output->next = NULL;
+    if (bl_app->last_output != NULL) {
+        bl_app->last_output->next = output;
+    } else {
+        bl_app->first_output = output;
+    }
+    bl_app->last_output = output;
+
+    return output;
+}
+
+void bl_output_free(bl_output *output)
+{
+    for (bl_window *window = bl_app->first_window; window != NULL;
+            window = window->next) {
+        bl_surface_remove_output(window->surface, output);
+    }
+
+    if (output->prev != NULL) {
+        output->prev->next = output->next;
+    } else {
+        bl_app->first_output = output->next;
+    }
+    if (output->next != NULL) {
+        output->next->prev = output->prev;
+    } else {
+        bl_app->last_output = output->prev;
+    }
+
+    wl_output_destroy(output->output);
+
+    free(output);
+}
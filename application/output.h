@@ -0,0 +1,28 @@
+#ifndef _BLUSHER_OUTPUT_H
+#define _BLUSHER_OUTPUT_H
+
+#include <stdint.h>
+
+#include <wayland-client.h>
+
+typedef struct bl_output {
+    /// \brief Siblings in the application output list.
+    struct bl_output *prev;
+    struct bl_output *next;
+
+    struct wl_output *output;
+    /// \brief Registry name of the global.
+    uint32_t id;
+    int32_t scale;
+    /// \brief Scale received but not yet applied by wl_output.done.
+    int32_t pending_scale;
+} bl_output;
+
+/// \brief Bind the wl_output global and add it to the application.
+bl_output* bl_output_new(struct wl_registry *registry, uint32_t id,
+        uint32_t version);
+
+/// \brief Remove the output from the application and surfaces, then free.
+void bl_output_free(bl_output *output);
+
+#endif /* _BLUSHER_OUTPUT_H */
@@ -5,6 +5,10 @@
 
 #include <linux/input.h>
 
+/// \brief Pointer event delivered to bl_surface handlers.
+///
+/// Events are owned by the application and only valid during the handler
+/// call. Copy the structure if it is needed after the handler returns.
 typedef struct bl_pointer_event {
     uint32_t serial;
 
@@ -13,8 +17,4 @@ typedef struct bl_pointer_event {
     int32_t y;
 } bl_pointer_event;
 
-bl_pointer_event* bl_pointer_event_new();
-
-void bl_pointer_event_free(bl_pointer_event *event);
-
 #endif /* _BLUSHER_POINTER_EVENT_H */
@@ -0,0 +1,226 @@
+#include "presentation-stats.h"
+
+// Std libs
+#include <inttypes.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <stable/presentation-time.h>
+
+// Blusher
+#include "application.h"
+
+typedef struct bl_pending_feedback {
+    struct bl_pending_feedback *prev;
+    struct bl_pending_feedback *next;
+
+    struct wp_presentation_feedback *feedback;
+    bl_presentation_stats *stats;
+    uint64_t submitted;
+} bl_pending_feedback;
+
+static uint64_t timestamp(clockid_t clock_id)
+{
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void add_sample(bl_presentation_stats *stats,
+        const bl_presentation_sample *sample)
+{
+    stats->samples[stats->head % BLUSHER_PRESENTATION_STATS_CAPACITY] =
+        *sample;
+    stats->head += 1;
+}
+
+static void remove_pending(bl_pending_feedback *pending)
+{
+    if (pending->prev != NULL) {
+        pending->prev->next = pending->next;
+    } else {
+        pending->stats->first_pending = pending->next;
+    }
+    if (pending->next != NULL) {
+        pending->next->prev = pending->prev;
+    }
+    wp_presentation_feedback_destroy(pending->feedback);
+    free(pending);
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+    uint64_t lhs = *(const uint64_t*)a;
+    uint64_t rhs = *(const uint64_t*)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+//=============
+// Feedback
+//=============
+
+static void feedback_sync_output_handler(void *data,
+        struct wp_presentation_feedback *feedback, struct wl_output *output)
+{
+    (void)data;
+    (void)feedback;
+    (void)output;
+}
+
+static void feedback_presented_handler(void *data,
+        struct wp_presentation_feedback *feedback,
+        uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+        uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+    bl_pending_feedback *pending = (bl_pending_feedback*)data;
+    (void)feedback;
+    (void)seq_hi;
+    (void)seq_lo;
+
+    uint64_t sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo;
+
+    bl_presentation_sample sample = {
+        .submitted = pending->submitted,
+        .presented = (sec * 1000000000) + tv_nsec,
+        .refresh = refresh,
+        .flags = flags,
+        .missed = 0,
+        .discarded = 0,
+    };
+
+    // Measured against the frame's own submit time, not the previous
+    // frame, so idle gaps between repaints do not count as late. A frame
+    // shown within one refresh interval of its commit is on time.
+    if (refresh != 0 && sample.presented > sample.submitted) {
+        sample.missed = (sample.presented - sample.submitted) / refresh;
+    }
+
+    add_sample(pending->stats, &sample);
+
+    remove_pending(pending);
+}
+
+static void feedback_discarded_handler(void *data,
+        struct wp_presentation_feedback *feedback)
+{
+    bl_pending_feedback *pending = (bl_pending_feedback*)data;
+    (void)feedback;
+
+    bl_presentation_sample sample = {
+        .submitted = pending->submitted,
+        .presented = 0,
+        .refresh = 0,
+        .flags = 0,
+        .missed = 0,
+        .discarded = 1,
+    };
+    add_sample(pending->stats, &sample);
+
+    remove_pending(pending);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+    .sync_output = feedback_sync_output_handler,
+    .presented = feedback_presented_handler,
+    .discarded = feedback_discarded_handler,
+};
+
+//======================
+// Presentation Stats
+//======================
+
+bl_presentation_stats* bl_presentation_stats_new()
+{
+    bl_presentation_stats *stats = malloc(sizeof(bl_presentation_stats));
+
+    stats->head = 0;
+    stats->first_pending = NULL;
+
+    return stats;
+}
+
+void bl_presentation_stats_frame_submitted(bl_presentation_stats *stats,
+        struct wl_surface *wl_surface)
+{
+    if (bl_app->presentation == NULL) {
+        return;
+    }
+
+    bl_pending_feedback *pending = malloc(sizeof(bl_pending_feedback));
+    pending->stats = stats;
+    pending->submitted = timestamp(bl_app->presentation_clock_id);
+    pending->feedback = wp_presentation_feedback(bl_app->presentation,
+        wl_surface);
+    wp_presentation_feedback_add_listener(pending->feedback,
+        &feedback_listener, (void*)pending);
+
+    pending->prev = NULL;
+    pending->next = stats->first_pending;
+    if (stats->first_pending != NULL) {
+        stats->first_pending->prev = pending;
+    }
+    stats->first_pending = pending;
+}
+
+void bl_presentation_stats_report(bl_presentation_stats *stats,
+        FILE *stream)
+{
+    uint64_t head = stats->head;
+    uint64_t count = (head < BLUSHER_PRESENTATION_STATS_CAPACITY)
+        ? head
+        : BLUSHER_PRESENTATION_STATS_CAPACITY;
+
+    uint64_t latencies[BLUSHER_PRESENTATION_STATS_CAPACITY];
+    uint32_t latencies_length = 0;
+    uint32_t discarded = 0;
+    uint32_t late = 0;
+    uint32_t missed = 0;
+    uint32_t not_vsync = 0;
+    for (uint64_t i = head - count; i < head; ++i) {
+        bl_presentation_sample *sample =
+            &stats->samples[i % BLUSHER_PRESENTATION_STATS_CAPACITY];
+        if (sample->discarded) {
+            discarded += 1;
+            continue;
+        }
+        if (sample->presented > sample->submitted) {
+            latencies[latencies_length] =
+                sample->presented - sample->submitted;
+            latencies_length += 1;
+        }
+        if (sample->missed > 0) {
+            late += 1;
+            missed += sample->missed;
+        }
+        if (!(sample->flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC)) {
+            not_vsync += 1;
+        }
+    }
+
+    fprintf(stream, "Presentation stats - last %" PRIu64 " of %" PRIu64
+        " frames\n", count, head);
+    fprintf(stream, " - discarded: %u\n", discarded);
+    fprintf(stream, " - late: %u (%u vblanks missed)\n", late, missed);
+    fprintf(stream, " - not vsync aligned: %u\n", not_vsync);
+    if (latencies_length == 0) {
+        return;
+    }
+
+    qsort(latencies, latencies_length, sizeof(uint64_t), compare_latency);
+    uint32_t last = latencies_length - 1;
+    fprintf(stream, " - latency ms: p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+        latencies[last * 50 / 100] / 1000000.0,
+        latencies[last * 90 / 100] / 1000000.0,
+        latencies[last * 99 / 100] / 1000000.0,
+        latencies[last] / 1000000.0);
+}
+
+void bl_presentation_stats_free(bl_presentation_stats *stats)
+{
+    while (stats->first_pending != NULL) {
+        remove_pending(stats->first_pending);
+    }
+    free(stats);
+}
@@ -0,0 +1,55 @@
+#ifndef _BLUSHER_PRESENTATION_STATS_H
+#define _BLUSHER_PRESENTATION_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <wayland-client.h>
+
+#define BLUSHER_PRESENTATION_STATS_CAPACITY 1024
+
+typedef struct bl_pending_feedback bl_pending_feedback;
+
+typedef struct bl_presentation_sample {
+    /// \brief Commit time in nanoseconds of the presentation clock.
+    uint64_t submitted;
+    /// \brief Presentation time in nanoseconds. 0 if discarded.
+    uint64_t presented;
+    /// \brief Refresh interval in nanoseconds. 0 if unknown.
+    uint32_t refresh;
+    /// \brief Bitwise OR of wp_presentation_feedback_kind.
+    uint32_t flags;
+    /// \brief Vblanks passed between the commit and the presentation.
+    uint32_t missed;
+    int discarded;
+} bl_presentation_sample;
+
+/// \brief wp_presentation feedback of a surface.
+///
+/// Keeps the last samples in a ring buffer. Not thread safe, report from
+/// the thread dispatching Wayland events.
+typedef struct bl_presentation_stats {
+    bl_presentation_sample samples[BLUSHER_PRESENTATION_STATS_CAPACITY];
+    /// \brief Number of samples ever written.
+    uint64_t head;
+
+    /// \brief Feedback not received yet, destroyed on free.
+    bl_pending_feedback *first_pending;
+} bl_presentation_stats;
+
+bl_presentation_stats* bl_presentation_stats_new();
+
+/// \brief Request feedback for the next commit of wl_surface.
+///
+/// Call right before the commit. Does nothing if the compositor does not
+/// support wp_presentation.
+void bl_presentation_stats_frame_submitted(bl_presentation_stats *stats,
+        struct wl_surface *wl_surface);
+
+/// \brief Print latency percentiles, late, dropped and non-vsync frames.
+void bl_presentation_stats_report(bl_presentation_stats *stats,
+        FILE *stream);
+
+void bl_presentation_stats_free(bl_presentation_stats *stats);
+
+#endif /* _BLUSHER_PRESENTATION_STATS_H */
@@ -3,6 +3,7 @@
 // Std libs
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 
 // Unix
 #include <sys/mman.h>
@@ -10,19 +11,19 @@
 
 // Blusher
 #include "application.h"
+#include "output.h"
+#include "timer.h"
 #include "utils.h"
-#include <blusher-collections.h>
 
 //=============
 // Drawing
 //=============
+/// \brief Map size bytes of shared memory and create a buffer at the start.
 static struct wl_buffer* create_buffer(bl_surface *surface,
-        int width, int height, struct wl_shm *shm)
+        int width, int height, int size, struct wl_shm *shm)
 {
     fprintf(stderr, "create_buffer: %dx%d\n", width, height);
-    struct wl_shm_pool *pool;
     int stride = width * 4;
-    int size = stride * height;
     int fd;
     struct wl_buffer *buff;
 
@@ -33,51 +34,663 @@ static struct wl_buffer* create_buffer(bl_surface *surface,
         exit(1);
     }
 
-    fprintf(stderr, "Before mmap.");
-    fprintf(stderr, " shm_data: %p\n", surface->shm_data);
     surface->shm_data =
         mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    fprintf(stderr, "After mmap. shm_data: %p\n", surface->shm_data);
     if (surface->shm_data == MAP_FAILED) {
         surface->shm_data = NULL;
         close(fd);
         return NULL;
     }
 
-    pool = wl_shm_create_pool(shm, fd, size);
-    buff = wl_shm_pool_create_buffer(pool, 0, width, height, stride,
+    surface->shm_data_size = size;
+
+    surface->pool = wl_shm_create_pool(shm, fd, size);
+    buff = wl_shm_pool_create_buffer(surface->pool, 0, width, height, stride,
         WL_SHM_FORMAT_ARGB8888);
 
-    wl_shm_pool_destroy(pool);
+    close(fd);
     return buff;
 }
 
 static void paint_pixels(bl_surface *surface)
 {
-    uint32_t *pixel = surface->shm_data;
+    if (surface->paint != NULL) {
+        surface->paint(surface);
+        return;
+    }
+
+    // Flattened surfaces paint a view into the backing buffer, so the
+    // row stride may be larger than the width.
+    cairo_surface_t *view = surface->cairo_surface;
+    int width = cairo_image_surface_get_width(view);
+    int height = cairo_image_surface_get_height(view);
+    int stride = cairo_image_surface_get_stride(view);
 
     const uint32_t color = bl_color_to_argb(surface->color);
-    for (int n = 0; n < (surface->width * surface->height); ++n) {
-        *pixel++ = color;
+    unsigned char *row = cairo_image_surface_get_data(view);
+    for (int y = 0; y < height; ++y) {
+        uint32_t *pixel = (uint32_t*)row;
+        for (int x = 0; x < width; ++x) {
+            *pixel++ = color;
+        }
+        row += stride;
+    }
+}
+
+/// \brief Find the nearest surface owning a wl_surface.
+///
+/// The offset of the surface in the backing surface is accumulated to
+/// offset_x and offset_y if not NULL. Returns NULL for a detached subtree.
+static bl_surface* backing_surface(bl_surface *surface,
+        double *offset_x, double *offset_y)
+{
+    double x = 0;
+    double y = 0;
+
+    while (surface != NULL && surface->surface == NULL) {
+        x += surface->x;
+        y += surface->y;
+        surface = surface->parent;
+    }
+    if (offset_x != NULL) {
+        *offset_x = x;
+    }
+    if (offset_y != NULL) {
+        *offset_y = y;
+    }
+
+    return surface;
+}
+
+/// \brief Paint a flattened surface and its flattened descendants into
+/// the backing buffer at (x, y).
+static void paint_flattened(bl_surface *backing, bl_surface *surface,
+        double x, double y)
+{
+    // Surfaces with their own buffer are painted on their own.
+    if (surface->surface != NULL) {
+        return;
+    }
+
+    // Clip to the backing buffer, in buffer pixels.
+    cairo_surface_t *target = backing->cairo_surface;
+    double scale = backing->scale / 120.0;
+    int left = x < 0 ? 0 : round(x * scale);
+    int top = y < 0 ? 0 : round(y * scale);
+    int right = round((x + surface->width) * scale);
+    int bottom = round((y + surface->height) * scale);
+    if (right > cairo_image_surface_get_width(target)) {
+        right = cairo_image_surface_get_width(target);
+    }
+    if (bottom > cairo_image_surface_get_height(target)) {
+        bottom = cairo_image_surface_get_height(target);
+    }
+
+    if (left < right && top < bottom) {
+        int stride = cairo_image_surface_get_stride(target);
+        surface->shm_data = cairo_image_surface_get_data(target) +
+            (top * stride) + (left * 4);
+        surface->cairo_surface = cairo_image_surface_create_for_data(
+            surface->shm_data, CAIRO_FORMAT_ARGB32,
+            right - left, bottom - top, stride);
+        // Keep surface local coordinates when clipped at left or top.
+        cairo_surface_set_device_scale(surface->cairo_surface,
+            scale, scale);
+        cairo_surface_set_device_offset(surface->cairo_surface,
+            (x * scale) - left, (y * scale) - top);
+
+        paint_pixels(surface);
+
+        cairo_surface_destroy(surface->cairo_surface);
+        surface->cairo_surface = NULL;
+        surface->shm_data = NULL;
+    }
+
+    for (bl_surface *child = surface->first_child; child != NULL;
+            child = child->next_sibling) {
+        paint_flattened(backing, child, x + child->x, y + child->y);
+    }
+}
+
+static void paint_solid(bl_surface *surface);
+
+/// \brief Paint the surface buffer including flattened descendants.
+static void paint_tree(bl_surface *surface)
+{
+    if (surface->solid) {
+        paint_solid(surface);
+        surface->painted_serial = surface->content_serial;
+        return;
+    }
+
+    paint_pixels(surface);
+
+    for (bl_surface *child = surface->first_child; child != NULL;
+            child = child->next_sibling) {
+        paint_flattened(surface, child, child->x, child->y);
     }
+    surface->painted_serial = surface->content_serial;
 }
 
+//============
+// Tree
+//============
+static void append_child(bl_surface *parent, bl_surface *child)
+{
+    child->prev_sibling = parent->last_child;
+    child->next_sibling = NULL;
+    if (parent->last_child != NULL) {
+        parent->last_child->next_sibling = child;
+    } else {
+        parent->first_child = child;
+    }
+    parent->last_child = child;
+}
+
+static void remove_child(bl_surface *parent, bl_surface *child)
+{
+    if (child->prev_sibling != NULL) {
+        child->prev_sibling->next_sibling = child->next_sibling;
+    } else {
+        parent->first_child = child->next_sibling;
+    }
+    if (child->next_sibling != NULL) {
+        child->next_sibling->prev_sibling = child->prev_sibling;
+    } else {
+        parent->last_child = child->prev_sibling;
+    }
+    child->prev_sibling = NULL;
+    child->next_sibling = NULL;
+}
+
+static void mark_dirty(bl_surface *surface, uint32_t flags)
+{
+    surface->dirty |= flags;
+    if (flags & BL_SURFACE_DIRTY_PAINT) {
+        surface->content_serial += 1;
+    }
+
+    // Flattened surfaces are drawn as part of the backing buffer.
+    if (surface->surface == NULL &&
+            (flags & (BL_SURFACE_DIRTY_PAINT | BL_SURFACE_DIRTY_POSITION))) {
+        bl_surface *backing = backing_surface(surface, NULL, NULL);
+        if (backing != NULL) {
+            mark_dirty(backing, BL_SURFACE_DIRTY_PAINT);
+        }
+    }
+
+    // Ancestors already marked imply the rest of the path is marked too.
+    bl_surface *ancestor = surface->parent;
+    while (ancestor != NULL &&
+            !(ancestor->dirty & BL_SURFACE_DIRTY_CHILDREN)) {
+        ancestor->dirty |= BL_SURFACE_DIRTY_CHILDREN;
+        ancestor = ancestor->parent;
+    }
+}
+
+/// \brief Non-zero if a flattened descendant fills with a translucent color.
+/// Fills replace the pixels below, so they leave translucent holes.
+static int has_translucent_child(bl_surface *surface)
+{
+    for (bl_surface *child = surface->first_child; child != NULL;
+            child = child->next_sibling) {
+        if (child->surface != NULL) {
+            continue;
+        }
+        if ((child->paint == NULL && child->color.alpha < 255) ||
+                has_translucent_child(child)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/// \brief Tell the compositor it can skip blending below the surface.
+///
+/// The region is either the whole surface or empty. Paint hooks may leave
+/// transparent pixels, so only plain opaque fills count. Sent only when
+/// it changed.
+static void update_opaque_region(bl_surface *surface)
+{
+    int opaque = surface->paint == NULL && surface->color.alpha == 255 &&
+        !has_translucent_child(surface);
+    double width = opaque ? surface->width : 0;
+    double height = opaque ? surface->height : 0;
+    if (surface->opaque_width == width && surface->opaque_height == height) {
+        return;
+    }
+    surface->opaque_width = width;
+    surface->opaque_height = height;
+
+    if (!opaque) {
+        wl_surface_set_opaque_region(surface->surface, NULL);
+        return;
+    }
+    struct wl_region *region =
+        wl_compositor_create_region(bl_app->compositor);
+    wl_region_add(region, 0, 0, width, height);
+    wl_surface_set_opaque_region(surface->surface, region);
+    wl_region_destroy(region);
+}
+
+//=============
+// Scale
+//=============
+
+/// \brief Length in buffer pixels of a surface local length.
+static int to_pixels(bl_surface *surface, double length)
+{
+    return round(length * surface->scale / 120.0);
+}
+
+static void release_buffer(bl_surface_buffer *buffer)
+{
+    if (buffer->cairo_surface != NULL) {
+        cairo_surface_destroy(buffer->cairo_surface);
+    }
+    if (buffer->shm_data != NULL) {
+        munmap(buffer->shm_data, buffer->shm_data_size);
+    }
+    if (buffer->buffer != NULL) {
+        wl_buffer_destroy(buffer->buffer);
+    }
+    if (buffer->pool != NULL) {
+        wl_shm_pool_destroy(buffer->pool);
+    }
+    buffer->buffer = NULL;
+    buffer->pool = NULL;
+    buffer->shm_data = NULL;
+    buffer->shm_data_size = 0;
+    buffer->cairo_surface = NULL;
+}
+
+/// \brief Move the current buffer of the surface out to buffer.
+static void take_buffer(bl_surface *surface, bl_surface_buffer *buffer)
+{
+    buffer->buffer = surface->buffer;
+    buffer->pool = surface->pool;
+    buffer->shm_data = surface->shm_data;
+    buffer->shm_data_size = surface->shm_data_size;
+    buffer->cairo_surface = surface->cairo_surface;
+    buffer->scale = surface->scale;
+    buffer->width = surface->width;
+    buffer->height = surface->height;
+    buffer->painted_serial = surface->painted_serial;
+
+    surface->buffer = NULL;
+    surface->pool = NULL;
+    surface->shm_data = NULL;
+    surface->shm_data_size = 0;
+    surface->cairo_surface = NULL;
+}
+
+/// \brief Tell the compositor how buffer pixels map to the surface.
+static void apply_buffer_scale(bl_surface *surface)
+{
+    if (surface->viewport != NULL) {
+        // A destination below one unit is a bad_value protocol error.
+        if (surface->width >= 1 && surface->height >= 1) {
+            wp_viewport_set_destination(surface->viewport,
+                surface->width, surface->height);
+        } else {
+            wp_viewport_set_destination(surface->viewport, -1, -1);
+        }
+    } else {
+        wl_surface_set_buffer_scale(surface->surface, surface->scale / 120);
+    }
+}
+
+//=============
+// Solid
+//=============
+
+/// \brief A surface is solid if it owns a wl_surface and shows nothing
+/// but its color. Flattened children paint into the buffer, so they need
+/// a full size one.
+static int is_solid(bl_surface *surface)
+{
+    if (surface->surface == NULL || surface->paint != NULL ||
+            bl_app->viewporter == NULL) {
+        return 0;
+    }
+    for (bl_surface *child = surface->first_child; child != NULL;
+            child = child->next_sibling) {
+        if (child->surface == NULL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t premultiplied(uint32_t channel, uint32_t alpha)
+{
+    return (channel / 255.0) * (alpha / 255.0) * UINT32_MAX;
+}
+
+/// \brief Create a single pixel buffer of the surface color.
+static void create_solid_buffer(bl_surface *surface)
+{
+    const bl_color color = surface->color;
+
+    if (bl_app->single_pixel_buffer_manager != NULL) {
+        surface->buffer =
+            wp_single_pixel_buffer_manager_v1_create_u32_rgba_buffer(
+                bl_app->single_pixel_buffer_manager,
+                premultiplied(color.red, color.alpha),
+                premultiplied(color.green, color.alpha),
+                premultiplied(color.blue, color.alpha),
+                premultiplied(color.alpha, 255));
+        return;
+    }
+
+    surface->buffer = create_buffer(surface, 1, 1, 4, bl_app->shm);
+    if (surface->shm_data != NULL) {
+        *(uint32_t*)surface->shm_data = bl_color_to_argb(surface->color);
+    }
+}
+
+/// \brief Update the single pixel to the current color.
+static void paint_solid(bl_surface *surface)
+{
+    if (surface->shm_data != NULL) {
+        *(uint32_t*)surface->shm_data = bl_color_to_argb(surface->color);
+        return;
+    }
+
+    // Single pixel buffers are immutable.
+    if (surface->buffer != NULL) {
+        wl_buffer_destroy(surface->buffer);
+        surface->buffer = NULL;
+        create_solid_buffer(surface);
+    }
+}
+
+static void shrink_timeout_handler(bl_timer *timer, void *user_data);
+
+/// \brief Shrink the mapping once resizing stopped for a while.
+static void schedule_shrink(bl_surface *surface)
+{
+    if (surface->shrink_timer == NULL) {
+        surface->shrink_timer = bl_timer_new(shrink_timeout_handler, surface);
+        if (surface->shrink_timer == NULL) {
+            return;
+        }
+    }
+    // Restarted by every resize.
+    bl_timer_start(surface->shrink_timer, BLUSHER_SURFACE_SHRINK_DELAY, 0);
+}
+
+/// \brief Replace the buffer with one sized for the current size and scale.
+///
+/// The mapping is reused while the buffer fits in it. Outgrowing it maps
+/// half as much again, so the next steps of an interactive resize fit
+/// too. The headroom is given back by schedule_shrink().
+static void allocate_buffer(bl_surface *surface)
+{
+    if (surface->solid) {
+        bl_surface_buffer old;
+        take_buffer(surface, &old);
+        release_buffer(&old);
+
+        if (surface->width != 0 && surface->height != 0) {
+            create_solid_buffer(surface);
+        }
+        surface->painted_serial = surface->content_serial;
+        apply_buffer_scale(surface);
+        return;
+    }
+
+    int width = to_pixels(surface, surface->width);
+    int height = to_pixels(surface, surface->height);
+    int stride = width * 4;
+    int size = stride * height;
+
+    if (surface->cairo_surface != NULL) {
+        cairo_surface_destroy(surface->cairo_surface);
+        surface->cairo_surface = NULL;
+    }
+    if (surface->buffer != NULL) {
+        wl_buffer_destroy(surface->buffer);
+        surface->buffer = NULL;
+    }
+
+    if (size == 0) {
+        return;
+    }
+
+    if (surface->pool != NULL && size <= surface->shm_data_size) {
+        // Only the wl_buffer describing the mapping changes.
+        surface->buffer = wl_shm_pool_create_buffer(surface->pool, 0,
+            width, height, stride, WL_SHM_FORMAT_ARGB8888);
+    } else {
+        int grow = surface->pool != NULL;
+        bl_surface_buffer old;
+        take_buffer(surface, &old);
+        release_buffer(&old);
+
+        surface->buffer = create_buffer(surface, width, height,
+            grow ? size + (size / 2) : size, bl_app->shm);
+    }
+    if (size < surface->shm_data_size) {
+        schedule_shrink(surface);
+    }
+
+    // Let widgets draw straight into the compositor visible memory.
+    if (surface->shm_data != NULL) {
+        surface->cairo_surface = cairo_image_surface_create_for_data(
+            surface->shm_data, CAIRO_FORMAT_ARGB32,
+            width, height, stride);
+        cairo_surface_set_device_scale(surface->cairo_surface,
+            surface->scale / 120.0, surface->scale / 120.0);
+    }
+    // The new buffer holds no contents yet.
+    surface->painted_serial = surface->content_serial - 1;
+    apply_buffer_scale(surface);
+}
+
+static void shrink_timeout_handler(bl_timer *timer, void *user_data)
+{
+    bl_surface *surface = (bl_surface*)user_data;
+
+    int size = to_pixels(surface, surface->width) * 4 *
+        to_pixels(surface, surface->height);
+    if (surface->solid || surface->pool == NULL ||
+            size >= surface->shm_data_size) {
+        return;
+    }
+
+    // Map again at the exact size and repaint.
+    bl_surface_buffer old;
+    take_buffer(surface, &old);
+    release_buffer(&old);
+    allocate_buffer(surface);
+
+    surface->dirty |= BL_SURFACE_DIRTY_PAINT;
+    mark_dirty(surface, BL_SURFACE_DIRTY_NONE);
+}
+
+/// \brief Switch between a single pixel and a full size buffer if the
+/// surface started or stopped being solid.
+///
+/// Returns non-zero if the buffer was replaced.
+static int update_solid(bl_surface *surface)
+{
+    int solid = is_solid(surface);
+    if (solid == surface->solid) {
+        return 0;
+    }
+    surface->solid = solid;
+
+    if (solid && surface->viewport == NULL) {
+        surface->viewport = wp_viewporter_get_viewport(bl_app->viewporter,
+            surface->surface);
+        // The viewport maps the buffer, integer buffer scale is not used.
+        wl_surface_set_buffer_scale(surface->surface, 1);
+    }
+    // Neither kind of mapping is of use to the other.
+    bl_surface_buffer old;
+    take_buffer(surface, &old);
+    release_buffer(&old);
+    release_buffer(&(surface->scale_cache));
+    allocate_buffer(surface);
+    surface->dirty |= BL_SURFACE_DIRTY_PAINT;
+
+    return 1;
+}
+
+static void set_scale(bl_surface *surface, uint32_t scale)
+{
+    if (scale == 0 || surface->scale == scale) {
+        return;
+    }
+
+    // A single pixel looks the same at any scale.
+    if (surface->solid) {
+        surface->scale = scale;
+        return;
+    }
+
+    bl_surface_buffer previous;
+    take_buffer(surface, &previous);
+    surface->scale = scale;
+
+    bl_surface_buffer *cached = &(surface->scale_cache);
+    if (cached->buffer != NULL && cached->scale == scale &&
+            cached->width == surface->width &&
+            cached->height == surface->height &&
+            cached->painted_serial == surface->content_serial) {
+        // Moved back to an output of the previous scale. The old buffer
+        // is still up to date, attach it without painting.
+        surface->buffer = cached->buffer;
+        surface->pool = cached->pool;
+        surface->shm_data = cached->shm_data;
+        surface->shm_data_size = cached->shm_data_size;
+        surface->cairo_surface = cached->cairo_surface;
+        surface->painted_serial = cached->painted_serial;
+        *cached = previous;
+        apply_buffer_scale(surface);
+        surface->dirty |= BL_SURFACE_DIRTY_BUFFER;
+    } else {
+        release_buffer(cached);
+        *cached = previous;
+        if (surface->width != 0 && surface->height != 0) {
+            allocate_buffer(surface);
+        }
+        surface->dirty |= BL_SURFACE_DIRTY_PAINT;
+    }
+    // Propagate to ancestors without counting as a content change.
+    mark_dirty(surface, BL_SURFACE_DIRTY_NONE);
+}
+
+/// \brief Integer scale is the largest scale of the outputs the surface is on.
+static void update_integer_scale(bl_surface *surface)
+{
+    if (surface->fractional_scale != NULL) {
+        return;
+    }
+
+    int32_t scale = 1;
+    for (uint32_t i = 0; i < surface->outputs_length; ++i) {
+        if (surface->outputs[i]->scale > scale) {
+            scale = surface->outputs[i]->scale;
+        }
+    }
+    set_scale(surface, scale * 120);
+}
+
+static void surface_enter_handler(void *data, struct wl_surface *wl_surface,
+        struct wl_output *wl_output)
+{
+    bl_surface *surface = (bl_surface*)data;
+    bl_output *output = (bl_output*)wl_output_get_user_data(wl_output);
+
+    if (output == NULL ||
+            surface->outputs_length >= BLUSHER_SURFACE_MAX_OUTPUTS) {
+        return;
+    }
+    surface->outputs[surface->outputs_length] = output;
+    surface->outputs_length += 1;
+
+    update_integer_scale(surface);
+}
+
+static void remove_output(bl_surface *surface, bl_output *output)
+{
+    for (uint32_t i = 0; i < surface->outputs_length; ++i) {
+        if (surface->outputs[i] == output) {
+            surface->outputs_length -= 1;
+            surface->outputs[i] = surface->outputs[surface->outputs_length];
+            break;
+        }
+    }
+}
+
+static void surface_leave_handler(void *data, struct wl_surface *wl_surface,
+        struct wl_output *wl_output)
+{
+    bl_surface *surface = (bl_surface*)data;
+    bl_output *output = (bl_output*)wl_output_get_user_data(wl_output);
+
+    remove_output(surface, output);
+    update_integer_scale(surface);
+}
+
+static const struct wl_surface_listener surface_listener = {
+    .enter = surface_enter_handler,
+    .leave = surface_leave_handler,
+};
+
+static void fractional_scale_preferred_scale_handler(void *data,
+        struct wp_fractional_scale_v1 *fractional_scale, uint32_t scale)
+{
+    set_scale((bl_surface*)data, scale);
+}
+
+static const struct wp_fractional_scale_v1_listener fractional_scale_listener = {
+    .preferred_scale = fractional_scale_preferred_scale_handler,
+};
+
 //============
 // Surface
 //============
-bl_surface* bl_surface_new(bl_surface *parent)
+static bl_surface* surface_new(bl_surface *parent, int backed)
 {
     bl_surface *surface = malloc(sizeof(bl_surface));
 
     surface->parent = parent;
+    surface->first_child = NULL;
+    surface->last_child = NULL;
+    surface->prev_sibling = NULL;
+    surface->next_sibling = NULL;
+
+    surface->dirty = BL_SURFACE_DIRTY_NONE;
+    surface->user_data = NULL;
 
-    surface->surface = wl_compositor_create_surface(bl_app->compositor);
+    surface->surface = NULL;
     surface->subsurface = NULL;
     surface->frame_callback = NULL;
     surface->buffer = NULL;
+    surface->pool = NULL;
 
     surface->shm_data = NULL;
     surface->shm_data_size = 0;
+    surface->cairo_surface = NULL;
+
+    surface->scale = 120;
+    surface->viewport = NULL;
+    surface->fractional_scale = NULL;
+    surface->outputs_length = 0;
+    surface->content_serial = 0;
+    surface->painted_serial = 0;
+    surface->scale_cache.buffer = NULL;
+    surface->scale_cache.pool = NULL;
+    surface->scale_cache.shm_data = NULL;
+    surface->scale_cache.shm_data_size = 0;
+    surface->scale_cache.cairo_surface = NULL;
+    surface->solid = 0;
+    surface->shrink_timer = NULL;
+    surface->opaque_width = 0;
+    surface->opaque_height = 0;
 
     surface->x = 0;
     surface->y = 0;
@@ -89,42 +702,110 @@ bl_surface* bl_surface_new(bl_surface *parent)
     surface->pointer_press_event = NULL;
     surface->pointer_release_event = NULL;
 
-    // Create wl_subsurface if has parent.
+    surface->measure = NULL;
+    surface->layout = NULL;
+    surface->paint = NULL;
+
     if (surface->parent != NULL) {
-        surface->subsurface = wl_subcompositor_get_subsurface(
-            bl_app->subcompositor,
-            surface->surface,
-            surface->parent->surface
-        );
+        append_child(surface->parent, surface);
     }
 
-    // Add surface to BTree map.
-    bl_ptr_btree_insert(bl_app->surface_map,
-        (uint64_t)surface->surface, (uint64_t)surface);
+    if (backed) {
+        surface->surface = wl_compositor_create_surface(bl_app->compositor);
+
+        // Create wl_subsurface if has parent.
+        if (surface->parent != NULL) {
+            surface->subsurface = wl_subcompositor_get_subsurface(
+                bl_app->subcompositor,
+                surface->surface,
+                backing_surface(surface->parent, NULL, NULL)->surface
+            );
+        }
+
+        wl_surface_add_listener(surface->surface, &surface_listener, surface);
+
+        // Map wl_surface to bl_surface. Pointer events look up the target
+        // bl_surface through the wl_surface user data. Set explicitly, not
+        // left to the listener above.
+        wl_surface_set_user_data(surface->surface, surface);
+
+        // Prefer fractional scale. Buffers are then sized in pixels and
+        // mapped back to the surface size by the viewport.
+        if (bl_app->fractional_scale_manager != NULL &&
+                bl_app->viewporter != NULL) {
+            surface->viewport = wp_viewporter_get_viewport(bl_app->viewporter,
+                surface->surface);
+            surface->fractional_scale =
+                wp_fractional_scale_manager_v1_get_fractional_scale(
+                    bl_app->fractional_scale_manager, surface->surface);
+            wp_fractional_scale_v1_add_listener(surface->fractional_scale,
+                &fractional_scale_listener, surface);
+        }
+    }
 
     return surface;
 }
 
+bl_surface* bl_surface_new(bl_surface *parent)
+{
+    return surface_new(parent, parent == NULL);
+}
+
+bl_surface* bl_surface_new_subsurface(bl_surface *parent)
+{
+    return surface_new(parent, 1);
+}
+
 void bl_surface_set_geometry(bl_surface *surface,
         double x, double y, double width, double height)
 {
-    surface->x = x;
-    surface->y = y;
+    if (surface->x != x || surface->y != y) {
+        surface->x = x;
+        surface->y = y;
+        mark_dirty(surface, BL_SURFACE_DIRTY_POSITION);
+    }
+
+    // Buffer contents survive a move. Only a resize needs a new buffer.
+    if (surface->width == width && surface->height == height &&
+            (surface->surface == NULL || surface->buffer != NULL)) {
+        return;
+    }
     surface->width = width;
     surface->height = height;
 
-    if (surface->shm_data != NULL) {
-        munmap(surface->shm_data, surface->shm_data_size);
+    // Resizing a single pixel buffer is done by the compositor.
+    if (surface->solid && surface->buffer != NULL) {
+        if (width < 1 || height < 1) {
+            // Can't be the viewport destination. Unmap until it has a
+            // size again, which then allocates a new buffer.
+            bl_surface_buffer old;
+            take_buffer(surface, &old);
+            release_buffer(&old);
+            wp_viewport_set_destination(surface->viewport, -1, -1);
+        } else {
+            wp_viewport_set_destination(surface->viewport, width, height);
+        }
+        mark_dirty(surface, BL_SURFACE_DIRTY_LAYOUT | BL_SURFACE_DIRTY_BUFFER);
+        return;
     }
-    if (surface->buffer != NULL) {
-        wl_buffer_destroy(surface->buffer);
+    mark_dirty(surface, BL_SURFACE_DIRTY_LAYOUT | BL_SURFACE_DIRTY_PAINT);
+
+    // Flattened surfaces draw into the backing buffer.
+    if (surface->surface == NULL) {
+        return;
+    }
+
+    // A buffer of another size is no use when switching scale.
+    release_buffer(&(surface->scale_cache));
+    if (!update_solid(surface)) {
+        allocate_buffer(surface);
     }
-    surface->buffer = create_buffer(surface, width, height, bl_app->shm);
 }
 
 void bl_surface_set_color(bl_surface *surface, const bl_color color)
 {
     surface->color = color;
+    mark_dirty(surface, BL_SURFACE_DIRTY_PAINT);
 }
 
 void bl_surface_show(bl_surface *surface)
@@ -134,26 +815,233 @@ void bl_surface_show(bl_surface *surface)
         return;
     }
 
-    paint_pixels(surface);
-    wl_surface_attach(surface->surface, surface->buffer,
+    bl_surface *backing = backing_surface(surface, NULL, NULL);
+    if (backing == NULL) {
+        return;
+    }
+    update_solid(backing);
+    if (backing->buffer == NULL) {
+        return;
+    }
+
+    paint_tree(backing);
+    update_opaque_region(backing);
+    wl_surface_attach(backing->surface, backing->buffer,
         0, 0);
-    wl_surface_commit(surface->surface);
+    wl_surface_damage(backing->surface, 0, 0,
+        backing->width, backing->height);
+    wl_surface_commit(backing->surface);
 
-    if (surface->parent != NULL) {
-        wl_surface_commit(surface->parent->surface);
+    double x;
+    double y;
+    bl_surface *parent = (backing->parent != NULL) ?
+        backing_surface(backing->parent, &x, &y) : NULL;
+    if (parent != NULL) {
+        wl_subsurface_set_position(backing->subsurface,
+            x + backing->x, y + backing->y);
+        wl_surface_commit(parent->surface);
+    }
+    surface->dirty &= ~(BL_SURFACE_DIRTY_PAINT | BL_SURFACE_DIRTY_POSITION);
+    backing->dirty &= ~(BL_SURFACE_DIRTY_PAINT | BL_SURFACE_DIRTY_POSITION |
+        BL_SURFACE_DIRTY_BUFFER);
+}
+
+void bl_surface_measure(bl_surface *surface, double *width, double *height)
+{
+    if (surface->measure != NULL) {
+        surface->measure(surface, width, height);
+        return;
+    }
+    *width = surface->width;
+    *height = surface->height;
+}
+
+void bl_surface_invalidate(bl_surface *surface)
+{
+    mark_dirty(surface, BL_SURFACE_DIRTY_PAINT);
+}
+
+void bl_surface_invalidate_layout(bl_surface *surface)
+{
+    mark_dirty(surface, BL_SURFACE_DIRTY_LAYOUT);
+}
+
+/// \brief Update the subtree. Returns non-zero if the backing surface of
+/// the parent has to be committed.
+///
+/// moved is set when a flattened ancestor moved, so subsurfaces below it
+/// have to be positioned again.
+static int update_tree(bl_surface *surface, int moved)
+{
+    moved = moved || (surface->dirty & BL_SURFACE_DIRTY_POSITION);
+
+    // Arrange pass. May resize or move children and mark them dirty.
+    if ((surface->dirty & BL_SURFACE_DIRTY_LAYOUT) &&
+            surface->layout != NULL) {
+        surface->layout(surface);
+    }
+
+    // Children of a wl_surface are positioned relative to it.
+    int children_moved = (surface->surface == NULL) ? moved : 0;
+
+    // Clean subtrees are skipped entirely.
+    int needs_commit = 0;
+    for (bl_surface *child = surface->first_child; child != NULL;
+            child = child->next_sibling) {
+        if (child->dirty != BL_SURFACE_DIRTY_NONE || children_moved) {
+            if (update_tree(child, children_moved)) {
+                needs_commit = 1;
+            }
+        }
+    }
+
+    // Flattened surfaces are painted and committed by the backing surface.
+    if (surface->surface == NULL) {
+        surface->dirty = BL_SURFACE_DIRTY_NONE;
+        return needs_commit;
+    }
+
+    // Children or the paint hook may have changed.
+    if (surface->dirty & BL_SURFACE_DIRTY_PAINT) {
+        update_solid(surface);
+    }
+
+    if ((surface->dirty & (BL_SURFACE_DIRTY_PAINT | BL_SURFACE_DIRTY_BUFFER)) &&
+            surface->buffer != NULL &&
+            surface->width != 0 && surface->height != 0) {
+        if (surface->painted_serial != surface->content_serial) {
+            paint_tree(surface);
+        }
+        update_opaque_region(surface);
+        wl_surface_attach(surface->surface, surface->buffer, 0, 0);
+        wl_surface_damage(surface->surface, 0, 0,
+            surface->width, surface->height);
+        needs_commit = 1;
+    } else if ((surface->dirty & BL_SURFACE_DIRTY_BUFFER) &&
+            surface->buffer == NULL) {
+        // Resized to nothing.
+        wl_surface_attach(surface->surface, NULL, 0, 0);
+        needs_commit = 1;
+    }
+
+    int positioned = 0;
+    if (moved && surface->subsurface != NULL && surface->parent != NULL) {
+        double x;
+        double y;
+        backing_surface(surface->parent, &x, &y);
         wl_subsurface_set_position(surface->subsurface,
-            surface->x, surface->y);
+            x + surface->x, y + surface->y);
+        positioned = 1;
+    }
+
+    if (needs_commit) {
+        wl_surface_commit(surface->surface);
+    }
+
+    surface->dirty = BL_SURFACE_DIRTY_NONE;
+
+    // Synchronized subsurface state applies on parent commit.
+    return needs_commit || positioned;
+}
+
+int bl_surface_update(bl_surface *surface)
+{
+    if (surface->dirty == BL_SURFACE_DIRTY_NONE) {
+        return 0;
+    }
+    return update_tree(surface, 0);
+}
+
+void bl_surface_refresh_scale(bl_surface *surface)
+{
+    if (surface->surface != NULL) {
+        update_integer_scale(surface);
+    }
+    for (bl_surface *child = surface->first_child; child != NULL;
+            child = child->next_sibling) {
+        bl_surface_refresh_scale(child);
+    }
+}
+
+void bl_surface_remove_output(bl_surface *surface, bl_output *output)
+{
+    if (surface->surface != NULL) {
+        remove_output(surface, output);
+        update_integer_scale(surface);
+    }
+    for (bl_surface *child = surface->first_child; child != NULL;
+            child = child->next_sibling) {
+        bl_surface_remove_output(child, output);
     }
 }
 
+bl_surface* bl_surface_pick(bl_surface *surface, double x, double y,
+        double *local_x, double *local_y)
+{
+    // Last child is topmost.
+    for (bl_surface *child = surface->last_child; child != NULL;
+            child = child->prev_sibling) {
+        if (child->surface != NULL) {
+            continue;
+        }
+        if (x >= child->x && x < child->x + child->width &&
+                y >= child->y && y < child->y + child->height) {
+            return bl_surface_pick(child, x - child->x, y - child->y,
+                local_x, local_y);
+        }
+    }
+    *local_x = x;
+    *local_y = y;
+
+    return surface;
+}
+
 void bl_surface_free(bl_surface *surface)
 {
-    if (surface->buffer != NULL) {
-        wl_buffer_destroy(surface->buffer);
+    if (surface->parent != NULL) {
+        // Erase a flattened surface from the backing buffer.
+        bl_surface *backing = backing_surface(surface->parent, NULL, NULL);
+        if (surface->surface == NULL && backing != NULL) {
+            mark_dirty(backing, BL_SURFACE_DIRTY_PAINT);
+        }
+        remove_child(surface->parent, surface);
+    }
+    // Children become detached subtrees without links into this one.
+    bl_surface *child = surface->first_child;
+    while (child != NULL) {
+        bl_surface *next = child->next_sibling;
+        child->parent = NULL;
+        child->prev_sibling = NULL;
+        child->next_sibling = NULL;
+        child = next;
+    }
+    surface->first_child = NULL;
+    surface->last_child = NULL;
+    if (surface->surface == NULL) {
+        free(surface);
+        return;
     }
-    wl_surface_destroy(surface->surface);
 
-    bl_ptr_btree_remove(bl_app->surface_map, (uint64_t)(surface->surface));
+    bl_surface_buffer buffer;
+    take_buffer(surface, &buffer);
+    release_buffer(&buffer);
+    release_buffer(&(surface->scale_cache));
+    if (surface->shrink_timer != NULL) {
+        bl_timer_free(surface->shrink_timer);
+    }
+    if (surface->fractional_scale != NULL) {
+        wp_fractional_scale_v1_destroy(surface->fractional_scale);
+    }
+    if (surface->viewport != NULL) {
+        wp_viewport_destroy(surface->viewport);
+    }
+    if (bl_app->pointer_surface == surface->surface) {
+        bl_app->pointer_surface = NULL;
+    }
+    if (surface->subsurface != NULL) {
+        wl_subsurface_destroy(surface->subsurface);
+    }
+    wl_surface_destroy(surface->surface);
 
     free(surface);
 }
@@ -1,22 +1,97 @@
 #ifndef _BLUSHER_SURFACE_H
 #define _BLUSHER_SURFACE_H
 
+#include <stdint.h>
+
 #include <wayland-client.h>
 
+#include <cairo.h>
+
 #include "color.h"
 
 typedef struct bl_pointer_event bl_pointer_event;
+typedef struct bl_output bl_output;
+typedef struct bl_timer bl_timer;
+
+#define BLUSHER_SURFACE_MAX_OUTPUTS 8
+/// \brief Milliseconds without resize before an oversized buffer is shrunk.
+#define BLUSHER_SURFACE_SHRINK_DELAY 500
+
+#define BL_SURFACE_DIRTY_NONE       0
+/// \brief Children need to be arranged again.
+#define BL_SURFACE_DIRTY_LAYOUT     (1 << 0)
+/// \brief Contents need to be painted again.
+#define BL_SURFACE_DIRTY_PAINT      (1 << 1)
+/// \brief Subsurface position changed.
+#define BL_SURFACE_DIRTY_POSITION   (1 << 2)
+/// \brief Some descendant is dirty.
+#define BL_SURFACE_DIRTY_CHILDREN   (1 << 3)
+/// \brief Buffer swapped without repaint, needs attach and commit.
+#define BL_SURFACE_DIRTY_BUFFER     (1 << 4)
+
+/// \brief Buffer of a surface kept for a scale not currently used.
+typedef struct bl_surface_buffer {
+    struct wl_buffer *buffer;
+    struct wl_shm_pool *pool;
+    void *shm_data;
+    int shm_data_size;
+    cairo_surface_t *cairo_surface;
+    /// \brief Scale in 120ths.
+    uint32_t scale;
+    double width;
+    double height;
+    uint32_t painted_serial;
+} bl_surface_buffer;
 
 typedef struct bl_surface {
     struct bl_surface *parent;
+    struct bl_surface *first_child;
+    struct bl_surface *last_child;
+    struct bl_surface *prev_sibling;
+    struct bl_surface *next_sibling;
+
+    /// \brief Bitwise OR of BL_SURFACE_DIRTY_* flags.
+    uint32_t dirty;
+    /// \brief Widget owning this surface, if any.
+    void *user_data;
 
+    /// \brief NULL if the surface is flattened into the parent buffer.
     struct wl_surface *surface;
     struct wl_subsurface *subsurface;
     struct wl_callback *frame_callback;
     struct wl_buffer *buffer;
+    /// \brief Pool over shm_data. Kept to create buffers of other sizes
+    /// without a new mapping.
+    struct wl_shm_pool *pool;
 
     void *shm_data;
+    /// \brief Size of the mapping. May exceed the buffer while resizing.
     int shm_data_size;
+    /// \brief Cairo image surface drawing directly into shm_data.
+    cairo_surface_t *cairo_surface;
+
+    /// \brief Buffer scale in 120ths, as in wp_fractional_scale_v1.
+    uint32_t scale;
+    /// \brief Used with fractional scale or a solid buffer. NULL otherwise.
+    struct wp_viewport *viewport;
+    struct wp_fractional_scale_v1 *fractional_scale;
+    /// \brief Outputs the surface is on, for the integer scale.
+    bl_output *outputs[BLUSHER_SURFACE_MAX_OUTPUTS];
+    uint32_t outputs_length;
+    /// \brief Incremented when the contents change.
+    uint32_t content_serial;
+    /// \brief content_serial of the contents in the current buffer.
+    uint32_t painted_serial;
+    /// \brief Buffer of the previous scale, reused when switching back.
+    bl_surface_buffer scale_cache;
+    /// \brief Non-zero if the buffer is a single pixel of color stretched
+    /// by the viewport. Used when there is nothing to paint but the color.
+    int solid;
+    /// \brief Shrinks an oversized buffer once resizing stopped.
+    bl_timer *shrink_timer;
+    /// \brief Size of the opaque region last sent. Zero if none.
+    double opaque_width;
+    double opaque_height;
 
     double x;
     double y;
@@ -24,13 +99,27 @@ typedef struct bl_surface {
     double height;
     bl_color color;
 
-    void (*pointer_move_event)(struct bl_surface*, bl_pointer_event*);
-    void (*pointer_press_event)(struct bl_surface*, bl_pointer_event*);
-    void (*pointer_release_event)(struct bl_surface*, bl_pointer_event*);
+    void (*pointer_move_event)(struct bl_surface*, const bl_pointer_event*);
+    void (*pointer_press_event)(struct bl_surface*, const bl_pointer_event*);
+    void (*pointer_release_event)(struct bl_surface*, const bl_pointer_event*);
+
+    /// \brief Report preferred size. Current size is used if NULL.
+    void (*measure)(struct bl_surface*, double *width, double *height);
+    /// \brief Arrange children with bl_surface_set_geometry.
+    void (*layout)(struct bl_surface*);
+    /// \brief Paint contents. Fills with color if NULL.
+    void (*paint)(struct bl_surface*);
 } bl_surface;
 
+/// \brief Create a surface. A child surface is flattened: it has no
+/// wl_surface and is painted into the buffer of its parent.
 bl_surface* bl_surface_new(bl_surface *parent);
 
+/// \brief Create a child surface with its own wl_surface and wl_subsurface.
+///
+/// Use for GL, video or frequently moving content.
+bl_surface* bl_surface_new_subsurface(bl_surface *parent);
+
 void bl_surface_set_geometry(bl_surface *surface,
         double x, double y, double width, double height);
 
@@ -38,6 +127,33 @@ void bl_surface_set_color(bl_surface *surface, const bl_color color);
 
 void bl_surface_show(bl_surface *surface);
 
+void bl_surface_measure(bl_surface *surface, double *width, double *height);
+
+/// \brief Schedule repaint of the surface on the next update.
+void bl_surface_invalidate(bl_surface *surface);
+
+/// \brief Schedule re-arranging of the children on the next update.
+void bl_surface_invalidate_layout(bl_surface *surface);
+
+/// \brief Lay out, paint and commit only the dirty parts of the subtree.
+///
+/// Layout hooks must not invalidate ancestors of the surface being laid out.
+/// Returns non-zero if anything was committed.
+int bl_surface_update(bl_surface *surface);
+
+/// \brief Recompute the integer scale of surfaces in the subtree from
+/// their outputs.
+void bl_surface_refresh_scale(bl_surface *surface);
+
+/// \brief Forget a removed output in the subtree.
+void bl_surface_remove_output(bl_surface *surface, bl_output *output);
+
+/// \brief Find the topmost flattened descendant at surface local (x, y).
+///
+/// Returns the surface itself if no descendant is there.
+bl_surface* bl_surface_pick(bl_surface *surface, double x, double y,
+        double *local_x, double *local_y);
+
 void bl_surface_free(bl_surface *surface);
 
 #endif /* _BLUSHER_SURFACE_H */
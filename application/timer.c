@@ -0,0 +1,85 @@
+#include "timer.h"
+
+// Std libs
+#include <stdlib.h>
+#include <stdio.h>
+
+// Unix
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Blusher
+#include "fd-watch.h"
+
+static void timer_ready_handler(bl_fd_watch *watch, uint32_t events,
+        void *user_data)
+{
+    bl_timer *timer = (bl_timer*)user_data;
+    uint64_t expirations;
+
+    // Missed expirations are collapsed into one callback.
+    if (read(timer->fd, &expirations, sizeof(expirations)) !=
+            sizeof(expirations)) {
+        return;
+    }
+    timer->callback(timer, timer->user_data);
+}
+
+static void set_time(struct timespec *spec, uint32_t milliseconds)
+{
+    spec->tv_sec = milliseconds / 1000;
+    spec->tv_nsec = (milliseconds % 1000) * 1000000;
+}
+
+//=============
+// Timer
+//=============
+bl_timer* bl_timer_new(void (*callback)(bl_timer*, void*), void *user_data)
+{
+    bl_timer *timer = malloc(sizeof(bl_timer));
+
+    timer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer->fd < 0) {
+        fprintf(stderr, "bl_timer_new() - timerfd_create failed: %m\n");
+        free(timer);
+
+        return NULL;
+    }
+    timer->callback = callback;
+    timer->user_data = user_data;
+    timer->watch = bl_fd_watch_new(timer->fd, EPOLLIN,
+        timer_ready_handler, timer);
+
+    return timer;
+}
+
+void bl_timer_start(bl_timer *timer, uint32_t timeout, uint32_t interval)
+{
+    struct itimerspec spec;
+
+    // Zero it_value disarms the timer, so fire immediately as 1 ns.
+    set_time(&(spec.it_value), timeout);
+    if (timeout == 0) {
+        spec.it_value.tv_nsec = 1;
+    }
+    set_time(&(spec.it_interval), interval);
+
+    timerfd_settime(timer->fd, 0, &spec, NULL);
+}
+
+void bl_timer_stop(bl_timer *timer)
+{
+    struct itimerspec spec = { 0 };
+
+    timerfd_settime(timer->fd, 0, &spec, NULL);
+}
+
+void bl_timer_free(bl_timer *timer)
+{
+    if (timer->watch != NULL) {
+        bl_fd_watch_free(timer->watch);
+    }
+    close(timer->fd);
+
+    free(timer);
+}
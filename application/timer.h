@@ -0,0 +1,28 @@
+#ifndef _BLUSHER_TIMER_H
+#define _BLUSHER_TIMER_H
+
+#include <stdint.h>
+
+typedef struct bl_fd_watch bl_fd_watch;
+
+typedef struct bl_timer {
+    /// \brief CLOCK_MONOTONIC timerfd.
+    int fd;
+    bl_fd_watch *watch;
+
+    void (*callback)(struct bl_timer*, void *user_data);
+    void *user_data;
+} bl_timer;
+
+bl_timer* bl_timer_new(void (*callback)(bl_timer*, void*), void *user_data);
+
+/// \brief Fire after timeout milliseconds, then every interval milliseconds.
+///
+/// An interval of 0 fires only once.
+void bl_timer_start(bl_timer *timer, uint32_t timeout, uint32_t interval);
+
+void bl_timer_stop(bl_timer *timer);
+
+void bl_timer_free(bl_timer *timer);
+
+#endif /* _BLUSHER_TIMER_H */
@@ -13,7 +13,7 @@
 // Events
 //=================
 static void title_bar_pointer_press_handler(bl_surface *surface,
-        bl_pointer_event *event)
+        const bl_pointer_event *event)
 {
     if (event->button == BTN_LEFT) {
 //        bl_application_remove_window()
@@ -21,6 +21,17 @@ static void title_bar_pointer_press_handler(bl_surface *surface,
     }
 }
 
+//=================
+// Layout
+//=================
+static void title_bar_layout(bl_surface *surface)
+{
+    bl_title_bar *title_bar = (bl_title_bar*)surface->user_data;
+
+    bl_surface_set_geometry(title_bar->close_button, 0, 0,
+        20, 20);
+}
+
 //=================
 // Title Bar
 //=================
@@ -30,7 +41,8 @@ bl_title_bar* bl_title_bar_new(bl_window *window)
 
     title_bar->surface = bl_surface_new(window->surface);
 
-    title_bar->surface->parent = window->surface;
+    title_bar->surface->user_data = title_bar;
+    title_bar->surface->layout = title_bar_layout;
     bl_surface_set_geometry(title_bar->surface, 0, 0,
         window->width, BLUSHER_TITLE_BAR_HEIGHT);
     bl_color color = bl_color_from_rgb(100, 100, 100);
@@ -40,8 +52,7 @@ bl_title_bar* bl_title_bar_new(bl_window *window)
 
     // Set close button.
     title_bar->close_button = bl_surface_new(title_bar->surface);
-    bl_surface_set_geometry(title_bar->close_button, 0, 0,
-        20, 20);
+    title_bar_layout(title_bar->surface);
     color = bl_color_from_rgb(255, 0, 0);
     bl_surface_set_color(title_bar->close_button, color);
     title_bar->close_button->pointer_press_event =
@@ -52,8 +63,8 @@ bl_title_bar* bl_title_bar_new(bl_window *window)
 
 void bl_title_bar_show(bl_title_bar *title_bar)
 {
+    // The close button is flattened into the same buffer.
     bl_surface_show(title_bar->surface);
-    bl_surface_show(title_bar->close_button);
 }
 
 void bl_title_bar_free(bl_title_bar *title_bar)
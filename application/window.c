@@ -1,6 +1,7 @@
 #include "window.h"
 
 #include <stdio.h>
+#include <time.h>
 
 #include <sys/mman.h>
 #include <unistd.h>
@@ -8,30 +9,24 @@
 #include "application.h"
 #include "surface.h"
 #include "title-bar.h"
+#include "animation.h"
 #include "pointer-event.h"
 #include "utils.h"
+#include "presentation-stats.h"
 
 //==============
 // Xdg
 //==============
 
-// Xdg shell
-static void xdg_wm_base_ping_handler(void *data,
-        struct xdg_wm_base *xdg_wm_base, uint32_t serial)
-{
-    xdg_wm_base_pong(xdg_wm_base, serial);
-}
-
-static const struct xdg_wm_base_listener xdg_wm_base_listener = {
-    .ping = xdg_wm_base_ping_handler,
-};
-
 // Xdg surface
 static void xdg_surface_configure_handler(void *data,
         struct xdg_surface *xdg_surface, uint32_t serial)
 {
-    fprintf(stderr, "xdg_surface_configure_handler.\n");
-    xdg_surface_ack_configure(xdg_surface, serial);
+    bl_window *window = (bl_window*)data;
+
+    // Acked by bl_window_update() with the commit of the new size.
+    window->configure_pending = 1;
+    window->configure_serial = serial;
 }
 
 static const struct xdg_surface_listener xdg_surface_listener = {
@@ -43,7 +38,26 @@ static void xdg_toplevel_configure_handler(void *data,
         struct xdg_toplevel *xdg_toplevel, int32_t width, int32_t height,
         struct wl_array *states)
 {
-    // printf("TOPLEVEL Configure: %dx%d\n", width, height);
+    bl_window *window = (bl_window*)data;
+
+    // Applied on the following xdg_surface.configure.
+    window->pending_width = width;
+    window->pending_height = height;
+}
+
+/// \brief Take the size of the latest configure and ack it. The ack
+/// applies to the next commit.
+static void apply_configure(bl_window *window)
+{
+    if (window->pending_width > 0 && window->pending_height > 0) {
+        window->width = window->pending_width;
+        window->height = window->pending_height;
+    }
+    bl_surface_set_geometry(window->surface,
+        0, 0, window->width, window->height);
+
+    xdg_surface_ack_configure(window->xdg_surface, window->configure_serial);
+    window->configure_pending = 0;
 }
 
 static void xdg_toplevel_close_handler(void *data,
@@ -58,37 +72,46 @@ static const struct xdg_toplevel_listener xdg_toplevel_listener = {
 };
 
 //=============
-// Drawing
+// Frame
 //=============
+static void frame_done_handler(void *data, struct wl_callback *callback,
+        uint32_t time);
+
+static const struct wl_callback_listener frame_listener = {
+    .done = frame_done_handler,
+};
 
-static void paint_pixels(int size, uint32_t color, void **shm_data)
+static uint32_t monotonic_time()
 {
-    fprintf(stderr, "paint_pixels. shm_data: %p\n", *shm_data);
-    uint32_t *pixel = *shm_data;
+    struct timespec now;
 
-    for (int n = 0; n < size; ++n) {
-        *pixel++ = color;
-    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec * 1000) + (now.tv_nsec / 1000000);
 }
 
-static void create_window_surface(bl_surface *window_surface)
+static void frame_done_handler(void *data, struct wl_callback *callback,
+        uint32_t time)
 {
-    fprintf(stderr, "create_window_surface. shm_data: %p\n",
-        window_surface->shm_data);
+    bl_window *window = (bl_window*)data;
 
-    wl_surface_attach(window_surface->surface,
-        window_surface->buffer, 0, 0);
-    wl_surface_commit(window_surface->surface);
+    wl_callback_destroy(callback);
+    window->surface->frame_callback = NULL;
 
-//    wl_buffer_destroy(buffer);
+    bl_window_update(window);
 }
 
-static void create_title_bar_surface(bl_surface *title_bar)
+//=============
+// Layout
+//=============
+static void window_layout(bl_surface *surface)
 {
-    wl_surface_attach(title_bar->surface, title_bar->buffer, 0, 0);
-    wl_surface_commit(title_bar->surface);
+    bl_window *window = (bl_window*)surface->user_data;
 
-//    wl_buffer_destroy(buffer);
+    if (window->title_bar != NULL) {
+        bl_surface_set_geometry(window->title_bar->surface, 0, 0,
+            surface->width, BLUSHER_TITLE_BAR_HEIGHT);
+    }
 }
 
 //=============
@@ -99,11 +122,12 @@ bl_window* bl_window_new()
 {
     bl_window *window = malloc(sizeof(bl_window));
 
-    window->xdg_wm_base = NULL;
+    window->prev = NULL;
+    window->next = NULL;
+
     window->xdg_surface = NULL;
     window->xdg_toplevel = NULL;
 
-    window->xdg_wm_base_listener = xdg_wm_base_listener;
     window->xdg_surface_listener = xdg_surface_listener;
     window->xdg_toplevel_listener = xdg_toplevel_listener;
 
@@ -111,100 +135,60 @@ bl_window* bl_window_new()
         fprintf(stderr, "bl_app is NULL.\n");
     }
     window->surface = bl_surface_new(NULL);
+    window->surface->user_data = window;
+    window->surface->layout = window_layout;
+    bl_surface_set_color(window->surface, bl_color_from_rgb(214, 209, 206));
 
     window->width = 480;
     window->height = 360;
+    window->configure_pending = 0;
+    window->configure_serial = 0;
+    window->pending_width = 0;
+    window->pending_height = 0;
     window->title = "Window";
 
     window->title_bar = NULL;
     window->body = NULL;
 
-    return window;
-}
-
-// TEST!!
-static void frame_done(void *data, struct wl_callback *callback, uint32_t time);
-
-static const struct wl_callback_listener window_listener = {
-    .done = frame_done,
-};
-
-static void frame_done(void *data, struct wl_callback *callback, uint32_t time)
-{
-    bl_surface *window_surface = (bl_surface*)data;
-
-    wl_callback_destroy(callback);
-    wl_surface_damage(window_surface->surface, 0, 0, 100, 100);
-    fprintf(stderr, "DRAW!!!!!!!\n");
-
-    struct wl_buffer *window_buffer = NULL;
-    create_window_surface(window_surface);
-    paint_pixels(480 * 360, 0xff0000, &(window_surface->shm_data));
-
-    window_surface->frame_callback = wl_surface_frame(window_surface->surface);
-    wl_surface_attach(window_surface->surface, window_buffer, 0, 0);
-    wl_callback_add_listener(window_surface->frame_callback,
-        &window_listener, (void*)window_surface);
-    wl_surface_commit(window_surface->surface);
-}
-
-static void frame_done_tb(void *data, struct wl_callback *callback, uint32_t time);
+    window->first_animation = NULL;
+    window->last_animation = NULL;
 
-static const struct wl_callback_listener listener = {
-    .done = frame_done_tb,
-};
+    window->presentation_stats = bl_presentation_stats_new();
 
-static void frame_done_tb(void *data, struct wl_callback *callback, uint32_t time)
-{
-    bl_surface *title_bar = (bl_surface*)data;
-    wl_callback_destroy(callback);
-    wl_surface_damage(title_bar->surface, 0, 0, 40, 100);
-    fprintf(stderr, "DRAW!!\n");
-
-    create_title_bar_surface(title_bar);
-    paint_pixels(title_bar->width * title_bar->height, 0x00ff00,
-        &(title_bar->shm_data));
-
-    title_bar->frame_callback = wl_surface_frame(title_bar->surface);
-    wl_surface_attach(title_bar->surface, title_bar->buffer, 0, 0);
-    wl_callback_add_listener(title_bar->frame_callback,
-        &listener, (void*)(title_bar));
-    wl_surface_commit(title_bar->surface);
+    return window;
 }
 
+// TEST!!
 static void title_bar_pointer_move_handler(bl_surface *surface,
-        bl_pointer_event *event)
+        const bl_pointer_event *event)
 {
 }
 
 static void title_bar_pointer_press_handler(bl_surface *surface,
-        bl_pointer_event *event)
+        const bl_pointer_event *event)
 {
     fprintf(stderr, "You have pressed button %d on title bar, (%d, %d)\n",
         event->button, event->x, event->y);
 
+    bl_title_bar *title_bar = (bl_title_bar*)surface->user_data;
+
     if (event->button == BTN_LEFT) {
-        xdg_toplevel_move(bl_app->toplevel_windows[0]->xdg_toplevel,
+        xdg_toplevel_move(title_bar->window->xdg_toplevel,
             bl_app->seat, event->serial);
     }
-
-    bl_pointer_event_free(event);
 }
 // TEST END!!
 
 void bl_window_show(bl_window *window)
 {
-    xdg_wm_base_add_listener(window->xdg_wm_base,
-        &(window->xdg_wm_base_listener), NULL);
-
-    window->xdg_surface = xdg_wm_base_get_xdg_surface(window->xdg_wm_base,
+    window->xdg_surface = xdg_wm_base_get_xdg_surface(bl_app->xdg_wm_base,
         window->surface->surface);
     xdg_surface_add_listener(window->xdg_surface,
-        &(window->xdg_surface_listener), NULL);
+        &(window->xdg_surface_listener), window);
 
     window->xdg_toplevel = xdg_surface_get_toplevel(window->xdg_surface);
     xdg_toplevel_add_listener(window->xdg_toplevel,
-        &(window->xdg_toplevel_listener), NULL);
+        &(window->xdg_toplevel_listener), window);
 
     // Signal that the surface is ready to be configured.
     wl_surface_commit(window->surface->surface);
@@ -213,12 +197,14 @@ void bl_window_show(bl_window *window)
     wl_display_roundtrip(bl_app->display);
 
     // Draw window surface.
-    bl_surface_set_geometry(window->surface,
-        0, 0, window->width, window->height);
-    create_window_surface(window->surface);
-    fprintf(stderr, "Before paint_pixels. shm_data: %p\n", window->surface->shm_data);
-    paint_pixels(window->width * window->height, 0xffd6d1ce,
-        &(window->surface->shm_data));
+    if (window->configure_pending) {
+        apply_configure(window);
+    } else {
+        bl_surface_set_geometry(window->surface,
+            0, 0, window->width, window->height);
+    }
+    // Painted through the surface so the buffer follows the output scale.
+    bl_surface_show(window->surface);
 
     // Draw title bar.
     window->title_bar = bl_title_bar_new(window);
@@ -228,25 +214,82 @@ void bl_window_show(bl_window *window)
         title_bar_pointer_press_handler;
     bl_title_bar_show(window->title_bar);
 
-    // TEST!
-//    window->surface->frame_callback =
-//        wl_surface_frame(window->surface->surface);
-//    wl_callback_add_listener(window->surface->frame_callback,
-//        &window_listener, (void*)(window->surface));
-//    wl_surface_commit(window->surface->surface);
-
-    window->title_bar->surface->frame_callback =
-        wl_surface_frame(window->title_bar->surface->surface);
-    wl_callback_add_listener(window->title_bar->surface->frame_callback,
-        &listener, (void*)(window->title_bar->surface));
-    wl_surface_commit(window->title_bar->surface->surface);
     wl_surface_commit(window->surface->surface);
 }
 
+void bl_window_update(bl_window *window)
+{
+    bl_surface *surface = window->surface;
+
+    // Throttled until the compositor shows the previous frame.
+    if (surface->frame_callback != NULL || surface->buffer == NULL) {
+        return;
+    }
+
+    // Step running animations. Finished ones are removed.
+    if (window->first_animation != NULL) {
+        uint32_t time = monotonic_time();
+        bl_animation *animation = window->first_animation;
+        while (animation != NULL) {
+            bl_animation *next = animation->next;
+            if (!animation->step(animation, time, animation->user_data)) {
+                bl_animation_free(animation);
+            }
+            animation = next;
+        }
+    }
+
+    // Configures since the last frame collapse into the latest one.
+    int acked = window->configure_pending;
+    if (acked) {
+        apply_configure(window);
+    }
+
+    // Idle. Request no frame callback at all.
+    if (surface->dirty == BL_SURFACE_DIRTY_NONE &&
+            window->first_animation == NULL) {
+        // The ack still needs a commit.
+        if (acked) {
+            wl_surface_commit(surface->surface);
+        }
+        return;
+    }
+
+    surface->frame_callback = wl_surface_frame(surface->surface);
+    wl_callback_add_listener(surface->frame_callback,
+        &frame_listener, (void*)window);
+    bl_presentation_stats_frame_submitted(window->presentation_stats,
+        surface->surface);
+
+    // The frame request needs a commit even if nothing was painted.
+    if (!bl_surface_update(surface)) {
+        wl_surface_commit(surface->surface);
+    }
+}
+
 void bl_window_free(bl_window *window)
 {
-    bl_title_bar_free(window->title_bar);
+    while (window->first_animation != NULL) {
+        bl_animation_free(window->first_animation);
+    }
+    if (window->surface->frame_callback != NULL) {
+        wl_callback_destroy(window->surface->frame_callback);
+    }
+    if (window->title_bar != NULL) {
+        bl_title_bar_free(window->title_bar);
+    }
+    if (window->xdg_toplevel != NULL) {
+        xdg_toplevel_destroy(window->xdg_toplevel);
+    }
+    if (window->xdg_surface != NULL) {
+        xdg_surface_destroy(window->xdg_surface);
+    }
     bl_surface_free(window->surface);
 
+    // Report on close, then drop the feedback still in flight.
+    fprintf(stderr, "Window \"%s\"\n", window->title);
+    bl_presentation_stats_report(window->presentation_stats, stderr);
+    bl_presentation_stats_free(window->presentation_stats);
+
     free(window);
 }
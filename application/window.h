@@ -10,29 +10,51 @@
 
 typedef struct bl_surface bl_surface;
 typedef struct bl_title_bar bl_title_bar;
+typedef struct bl_animation bl_animation;
+typedef struct bl_presentation_stats bl_presentation_stats;
 
 typedef struct bl_window {
+    /// \brief Siblings in the application window list.
+    struct bl_window *prev;
+    struct bl_window *next;
+
     bl_surface *surface;
 
-    struct xdg_wm_base *xdg_wm_base;
     struct xdg_surface *xdg_surface;
     struct xdg_toplevel *xdg_toplevel;
 
-    struct xdg_wm_base_listener xdg_wm_base_listener;
     struct xdg_surface_listener xdg_surface_listener;
     struct xdg_toplevel_listener xdg_toplevel_listener;
 
     int width;
     int height;
+    /// \brief Latest configure not applied yet. Earlier ones are dropped,
+    /// so only the newest size is painted.
+    int configure_pending;
+    uint32_t configure_serial;
+    /// \brief Size from xdg_toplevel.configure. Zero if left to us.
+    int pending_width;
+    int pending_height;
     const char *title;
     bl_title_bar *title_bar;
     bl_surface *body;
+
+    /// \brief Running animations. See bl_animation_new().
+    bl_animation *first_animation;
+    bl_animation *last_animation;
+
+    /// \brief Presentation feedback of committed frames.
+    bl_presentation_stats *presentation_stats;
 } bl_window;
 
 bl_window* bl_window_new();
 
 void bl_window_show(bl_window *window);
 
+/// \brief Step animations and repaint dirty surfaces, paced by frame
+/// callbacks. Does nothing while idle or waiting for the previous frame.
+void bl_window_update(bl_window *window);
+
 /// \brief Free the window. Should not call manually.
 void bl_window_free(bl_window *window);
 
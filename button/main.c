@@ -24,7 +24,6 @@ struct zxdg_surface_v6 *xdg_surface;
 struct zxdg_toplevel_v6 *xdg_toplevel;
 struct wl_egl_window *egl_window;
 //struct wl_region *region;
-struct wl_egl_window *button;
 struct wl_surface *button_surface;
 struct wl_region *button_region;
 
@@ -33,8 +32,47 @@ EGLConfig egl_conf;
 EGLSurface egl_surface;
 EGLContext egl_context;
 
-cairo_surface_t *cairo_surface;
+// Window surface. Kept for the life of the window.
+cairo_surface_t *cairo_surface = NULL;
+// Shared by every cairo GL surface.
 cairo_device_t *cairo_device;
+// Background and text of the window, rasterized once.
+cairo_surface_t *background = NULL;
+int needs_redraw = 0;
+
+//==============
+// Button
+//==============
+enum button_state {
+    BUTTON_STATE_NORMAL,
+    BUTTON_STATE_HOVER,
+    BUTTON_STATE_PRESSED,
+    BUTTON_STATE_LENGTH,
+};
+
+struct button {
+    int x;
+    int y;
+    int width;
+    int height;
+    char *label;
+    enum button_state state;
+    // Each state rasterized into a GL texture. Redrawn on label change,
+    // so hover and press only blit.
+    cairo_surface_t *textures[BUTTON_STATE_LENGTH];
+    int textures_stale;
+};
+
+struct button button_widget = {
+    .x = 10,
+    .y = 50,
+    .width = 100,
+    .height = 30,
+    .label = NULL,
+    .state = BUTTON_STATE_NORMAL,
+    .textures = { NULL, NULL, NULL },
+    .textures_stale = 1,
+};
 
 // Input devices
 struct wl_seat *seat = NULL;
@@ -170,6 +208,98 @@ static void init_cairo()
     }
 }
 
+static void button_set_label(struct button *button, const char *label)
+{
+    if (button->label != NULL && strcmp(button->label, label) == 0) {
+        return;
+    }
+    free(button->label);
+    button->label = strdup(label);
+    button->textures_stale = 1;
+    needs_redraw = 1;
+}
+
+static void button_set_state(struct button *button, enum button_state state)
+{
+    if (button->state == state) {
+        return;
+    }
+    button->state = state;
+    needs_redraw = 1;
+}
+
+static int button_contains(struct button *button, double x, double y)
+{
+    return x >= button->x && x < button->x + button->width &&
+        y >= button->y && y < button->y + button->height;
+}
+
+// Lay out the label once and paint it on every state texture.
+static void render_button_textures(struct button *button)
+{
+    static const double colors[BUTTON_STATE_LENGTH][3] = {
+        { 0.0, 0.0, 1.0 },  // Normal
+        { 0.3, 0.3, 1.0 },  // Hover
+        { 0.0, 0.0, 0.6 },  // Pressed
+    };
+    PangoLayout *layout = NULL;
+
+    for (int i = 0; i < BUTTON_STATE_LENGTH; ++i) {
+        if (button->textures[i] == NULL) {
+            button->textures[i] = cairo_gl_surface_create(cairo_device,
+                CAIRO_CONTENT_COLOR_ALPHA, button->width, button->height);
+        }
+        cairo_t *cr = cairo_create(button->textures[i]);
+
+        cairo_set_source_rgb(cr, colors[i][0], colors[i][1], colors[i][2]);
+        cairo_paint(cr);
+
+        if (layout == NULL) {
+            PangoFontDescription *desc;
+
+            layout = pango_cairo_create_layout(cr);
+            pango_layout_set_text(layout, button->label, -1);
+            desc = pango_font_description_from_string("serif");
+            pango_font_description_set_size(desc, pixel_to_pango_size(16));
+            pango_layout_set_font_description(layout, desc);
+            pango_font_description_free(desc);
+        }
+        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+        cairo_move_to(cr, 4, 4);
+        pango_cairo_show_layout(cr, layout);
+
+        cairo_destroy(cr);
+    }
+    g_object_unref(layout);
+
+    button->textures_stale = 0;
+}
+
+// Blits the cached textures. Text is only shaped when the label changed.
+static void draw_window()
+{
+    if (button_widget.textures_stale) {
+        render_button_textures(&button_widget);
+    }
+
+    cairo_t *cr = cairo_create(cairo_surface);
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, background, 0, 0);
+    cairo_paint(cr);
+
+    struct button *button = &button_widget;
+    cairo_set_source_surface(cr, button->textures[button->state],
+        button->x, button->y);
+    cairo_rectangle(cr, button->x, button->y, button->width, button->height);
+    cairo_fill(cr);
+
+    cairo_destroy(cr);
+
+    cairo_gl_surface_swapbuffers(cairo_surface);
+    needs_redraw = 0;
+}
+
 //============
 // Keyboard
 //============
@@ -237,18 +367,36 @@ static void pointer_leave_handler(void *data, struct wl_pointer *pointer,
         uint32_t serial, struct wl_surface *surface)
 {
     fprintf(stderr, "Pointer left surface %p\n", surface);
+    button_set_state(&button_widget, BUTTON_STATE_NORMAL);
 }
 
 static void pointer_motion_handler(void *data, struct wl_pointer *pointer,
         uint32_t time, wl_fixed_t sx, wl_fixed_t sy)
 {
 //    fprintf(stderr, "Pointer moved at %d %d\n", sx, sy);
+    double x = wl_fixed_to_double(sx);
+    double y = wl_fixed_to_double(sy);
+
+    if (!button_contains(&button_widget, x, y)) {
+        button_set_state(&button_widget, BUTTON_STATE_NORMAL);
+    } else if (button_widget.state == BUTTON_STATE_NORMAL) {
+        button_set_state(&button_widget, BUTTON_STATE_HOVER);
+    }
 }
 
 static void pointer_button_handler(void *data, struct wl_pointer *wl_pointer,
         uint32_t serial, uint32_t time, uint32_t button, uint32_t state)
 {
     fprintf(stderr, "Pointer button\n");
+    // Over the button. Press and release only switch the texture.
+    if (button == BTN_LEFT && button_widget.state != BUTTON_STATE_NORMAL) {
+        if (state == WL_POINTER_BUTTON_STATE_PRESSED) {
+            button_set_state(&button_widget, BUTTON_STATE_PRESSED);
+        } else {
+            button_set_state(&button_widget, BUTTON_STATE_HOVER);
+        }
+        return;
+    }
     if (button == BTN_LEFT && state == WL_POINTER_BUTTON_STATE_PRESSED) {
         fprintf(stderr, "Move! wl_pointer: %p, xdg_toplevel: %p\n",
             wl_pointer, xdg_toplevel);
@@ -322,7 +470,11 @@ static void create_window()
     // Cairo
     cairo_surface = cairo_gl_surface_create_for_egl(cairo_device, egl_surface,
         480, 360);
-    cairo_t *cr = cairo_create(cairo_surface);
+
+    // Background and text into a texture, blitted on every redraw.
+    background = cairo_gl_surface_create(cairo_device,
+        CAIRO_CONTENT_COLOR_ALPHA, 480, 360);
+    cairo_t *cr = cairo_create(background);
     int err = cairo_status(cr);
     if (err != CAIRO_STATUS_SUCCESS) {
         fprintf(stderr, "Cairo error on create %s\n",
@@ -332,40 +484,20 @@ static void create_window()
     cairo_set_source_rgb(cr, 0.0, 1.0, 0.0);
     cairo_paint(cr);
     draw_text(cr, 10, 10);
+    cairo_destroy(cr);
 
     if (eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context)) {
         fprintf(stderr, "Made current.\n");
     } else {
         fprintf(stderr, "Made current failed!\n");
     }
-
-    cairo_gl_surface_swapbuffers(cairo_surface);
-
-    cairo_surface_destroy(cairo_surface);
-    cairo_surface = NULL;
 }
 
 static void create_button()
 {
-    /*
-    button = wl_egl_window_create(surface, 100, 30);
-    if (button == EGL_NO_SURFACE) {
-        exit(1);
-    }
-
-    egl_surface =
-//        eglCreatePbufferSurface(egl_display, egl_conf, NULL);
-        eglCreateWindowSurface(egl_display, egl_conf, button, NULL);
-
-    cairo_surface = cairo_gl_surface_create_for_egl(cairo_device, egl_surface,
-        100, 30);
-    cairo_t *cr = cairo_create(cairo_surface);
-    cairo_set_source_rgb(cr, 0.0, 0.0, 1.0);
-    cairo_paint(cr);
-    draw_text(cr, 0, 0);
-
-    cairo_gl_surface_swapbuffers(cairo_surface);
-    */
+    // Drawn into the window with the same cairo device.
+    button_set_label(&button_widget, "ボタン");
+    draw_window();
 }
 
 static void init_egl()
@@ -519,9 +651,22 @@ int main(int argc, char *argv[])
     wl_surface_commit(surface);
 
     while (wl_display_dispatch(display) != -1) {
-        ;
+        // One redraw for all events of the dispatch.
+        if (needs_redraw) {
+            draw_window();
+        }
     }
 
+    for (int i = 0; i < BUTTON_STATE_LENGTH; ++i) {
+        if (button_widget.textures[i] != NULL) {
+            cairo_surface_destroy(button_widget.textures[i]);
+        }
+    }
+    free(button_widget.label);
+    cairo_surface_destroy(background);
+    cairo_surface_destroy(cairo_surface);
+    cairo_device_destroy(cairo_device);
+
     wl_display_disconnect(display);
 
     return 0;
@@ -301,9 +301,6 @@ int main(int argc, char *argv[])
     // Create a buffer.
     buffer = create_buffer(480, 360);
 
-    wl_surface_attach(surface, buffer, 0, 0);
-    wl_surface_commit(surface);
-
     // Drawing pixels.
     uint32_t *pixel = shm_data;
     for (int i = 0; i < 480 * 360; ++i) {
@@ -312,30 +309,33 @@ int main(int argc, char *argv[])
     }
 
     // Cairo
-    cairo_surface_t *cairo_surface = cairo_image_surface_create_from_png(
+    cairo_surface_t *image_surface = cairo_image_surface_create_from_png(
         "nyan-cat.png");
-    if (cairo_surface_status(cairo_surface) != CAIRO_STATUS_SUCCESS) {
+    if (cairo_surface_status(image_surface) != CAIRO_STATUS_SUCCESS) {
         fprintf(stderr, "Failed to load PNG image.\n");
         exit(1);
     }
-    unsigned char *image_data = cairo_image_surface_get_data(cairo_surface);
-    int image_width = cairo_image_surface_get_width(cairo_surface);
-    int image_height = cairo_image_surface_get_height(cairo_surface);
-
-    uint32_t *image_pixel = (uint32_t*)image_data;
-    uint32_t *target = (uint32_t*)shm_data;
-    for (int i = 0; i < image_height; ++i) {
-        for (int j = 0; j < image_width; ++j) {
-            *target = *image_pixel++;
-            ++target;
-            // Because our surface is larget than image, skip to next line.
-            if (j == image_width - 1) {
-                target += (480 - image_width);
-            }
-        }
-    }
 
+    // Wrap the shm buffer so cairo draws directly into it. ARGB32 matches
+    // WL_SHM_FORMAT_ARGB8888 and the stride of create_buffer().
+    cairo_surface_t *cairo_surface = cairo_image_surface_create_for_data(
+        shm_data, CAIRO_FORMAT_ARGB32, 480, 360, 480 * 4);
+    cairo_t *cr = cairo_create(cairo_surface);
+
+    cairo_set_source_surface(cr, image_surface, 0, 0);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_rectangle(cr, 0, 0,
+        cairo_image_surface_get_width(image_surface),
+        cairo_image_surface_get_height(image_surface));
+    cairo_fill(cr);
+
+    cairo_destroy(cr);
+    cairo_surface_flush(cairo_surface);
     cairo_surface_destroy(cairo_surface);
+    cairo_surface_destroy(image_surface);
+
+    wl_surface_attach(surface, buffer, 0, 0);
+    wl_surface_commit(surface);
 
     // Display loop.
     while (wl_display_dispatch(display) != -1) {
@@ -3,6 +3,9 @@ SOURCES += src/application.cpp \
     src/context.cpp \
     src/surface.cpp \
     src/keyboard-state.cpp \
+    src/presentation-stats.cpp \
+    src/key-repeat.cpp \
+    src/keymap.cpp \
     main.cpp
 
 INCLUDEPATH += ./include
@@ -10,9 +13,12 @@ INCLUDEPATH += ./include
 HEADERS += include/example/application.h \
     include/example/surface.h \
     include/example/keyboard-state.h \
+    include/example/presentation-stats.h \
+    include/example/key-repeat.h \
+    include/example/keymap.h \
     include/example/gl/context.h \
     include/example/gl/object.h
 
 CONFIG += link_pkgconfig
 
-PKGCONFIG += cairo
+PKGCONFIG += cairo xkbcommon
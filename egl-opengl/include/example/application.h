@@ -3,6 +3,7 @@
 
 // C
 #include <stdint.h>
+#include <time.h>
 
 // C++
 #include <vector>
@@ -12,6 +13,10 @@
 
 // Wayland protocols
 #include <wayland-protocols/stable/xdg-shell.h>
+#include <wayland-protocols/stable/presentation-time.h>
+
+#include <example/key-repeat.h>
+#include <example/keymap.h>
 
 class Surface;
 
@@ -20,6 +25,9 @@ class Application
 public:
     Application(int argc, char *argv[]);
 
+    /// Like wl_display_dispatch(), but also wakes up for key repeats.
+    int dispatch();
+
     struct wl_display* wl_display();
     void set_wl_display(struct wl_display *display);
 
@@ -41,11 +49,21 @@ public:
     struct xdg_wm_base* xdg_wm_base();
     void set_xdg_wm_base(struct xdg_wm_base *wm_base);
 
+    /// Null if the compositor has no wp_presentation.
+    struct wp_presentation* wp_presentation();
+    void set_wp_presentation(struct wp_presentation *presentation);
+
+    clockid_t presentation_clock_id() const;
+    void set_presentation_clock_id(clockid_t clock_id);
+
     uint32_t keyboard_rate() const;
     uint32_t keyboard_delay() const;
     void set_keyboard_rate(uint32_t rate);
     void set_keyboard_delay(uint32_t delay);
 
+    KeyRepeat& key_repeat();
+    Keymap& keymap();
+
     void add_surface(Surface *surface);
     void remove_surface(Surface *surface);
     std::vector<Surface*> surface_list() const;
@@ -61,9 +79,14 @@ private:
     struct wl_keyboard *_wl_keyboard;
     struct wl_pointer *_wl_pointer;
     struct xdg_wm_base *_xdg_wm_base;
+    struct wp_presentation *_wp_presentation;
+
+    clockid_t _presentation_clock_id;
 
     uint32_t _keyboard_rate;
     uint32_t _keyboard_delay;
+    KeyRepeat _key_repeat;
+    Keymap _keymap;
 
     std::vector<Surface*> _surface_list;
 
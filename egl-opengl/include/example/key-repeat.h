@@ -0,0 +1,47 @@
+#ifndef _KEY_REPEAT_H
+#define _KEY_REPEAT_H
+
+// C
+#include <stdint.h>
+
+// C++
+#include <functional>
+
+/// Synthesizes key repeat events from wl_keyboard.repeat_info.
+///
+/// A CLOCK_MONOTONIC timerfd is armed on press, so repeats are delivered
+/// by the event loop at exact times instead of being polled every frame.
+class KeyRepeat
+{
+public:
+    KeyRepeat();
+    ~KeyRepeat();
+
+    /// Poll this for POLLIN, then call dispatch().
+    int fd() const;
+
+    /// rate is repeats per second, delay is milliseconds.
+    /// A rate of 0 disables repeat.
+    void set_info(int32_t rate, int32_t delay);
+
+    void press(uint32_t key);
+    void release(uint32_t key);
+
+    /// Stop repeating, e.g. on keyboard focus leave.
+    void stop();
+
+    /// Emit one repeat for each expiration since the last dispatch.
+    void dispatch();
+
+    /// Called with the repeated key.
+    std::function<void(uint32_t)> repeat_event;
+
+private:
+    int _fd;
+    int32_t _rate;
+    int32_t _delay;
+    uint32_t _key;
+    bool _repeating;
+};
+
+#endif /* _KEY_REPEAT_H */
@@ -6,23 +6,14 @@
 class KeyboardState
 {
 public:
-    uint32_t rate;
-    uint32_t delay;
-
     bool pressed;       // Keyboard is pressed.
     uint32_t key;       // Pressed key.
-    bool repeat;        // Keyboard is repeating.
     bool processed;     // Key processed first time.
-    uint64_t time;
-    uint64_t pressed_time;  // Key pressed time in milliseconds.
-    uint64_t elapsed_time;  // Key elapsed time in milliseconds.
+    uint32_t repeats;   // Repeat events not processed yet. See KeyRepeat.
 
     bool repeating() const
     {
-        if (pressed_time == 0) {
-            return false;
-        }
-        return elapsed_time - pressed_time >= delay;
+        return repeats > 0;
     }
 
     bool should_processed(uint32_t key)
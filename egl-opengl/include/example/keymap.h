@@ -0,0 +1,72 @@
+#ifndef _KEYMAP_H
+#define _KEYMAP_H
+
+// C
+#include <stdint.h>
+
+// C++
+#include <vector>
+
+// xkbcommon
+#include <xkbcommon/xkbcommon.h>
+
+/// Translates wl_keyboard keys with xkbcommon.
+///
+/// Compiled keymaps are cached by content hash, so a keymap re-sent on
+/// reconnect or seat change is not compiled again. Translations for the
+/// current modifiers are kept in a table indexed by keycode.
+class Keymap
+{
+public:
+    static const uint32_t cache_size = 4;
+    static const uint32_t table_size = 256;
+
+public:
+    Keymap();
+    ~Keymap();
+
+    /// Takes ownership of fd. Returns false if the keymap is unusable,
+    /// the previous one is kept then.
+    bool set_keymap(uint32_t format, int fd, uint32_t size);
+
+    void update_modifiers(uint32_t depressed, uint32_t latched,
+            uint32_t locked, uint32_t group);
+
+    /// Lookups by evdev key from wl_keyboard.key. Keys past the table are
+    /// translated on every call, their text is valid until the next one.
+    xkb_keysym_t keysym(uint32_t key);
+    const char* utf8(uint32_t key);
+
+    /// False for keys like Shift, which must not repeat. True if no keymap
+    /// has been received.
+    bool key_repeats(uint32_t key) const;
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint32_t size;
+        struct xkb_keymap *keymap;
+    };
+
+    struct Lookup {
+        xkb_keysym_t keysym;
+        char utf8[8];
+        bool filled;
+    };
+
+    const Lookup& lookup(uint32_t key);
+    void clear_table();
+
+private:
+    struct xkb_context *_context;
+    std::vector<Entry> _cache;
+    uint32_t _cache_next;
+
+    struct xkb_keymap *_keymap;
+    struct xkb_state *_state;
+
+    Lookup _table[Keymap::table_size];
+    Lookup _uncached;
+};
+
+#endif /* _KEYMAP_H */
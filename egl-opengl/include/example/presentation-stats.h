@@ -0,0 +1,93 @@
+#ifndef _PRESENTATION_STATS_H
+#define _PRESENTATION_STATS_H
+
+// C
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// C++
+#include <vector>
+
+// Wayland core
+#include <wayland-client.h>
+
+// Wayland protocols
+#include <wayland-protocols/stable/presentation-time.h>
+
+/// Collects wp_presentation feedback of a surface.
+///
+/// Keeps the last samples in a fixed ring buffer. Not thread safe, call
+/// report() from the thread dispatching Wayland events.
+class PresentationStats
+{
+public:
+    struct Sample {
+        uint64_t submitted;     // Commit time in nanoseconds.
+        uint64_t presented;     // Presentation time in nanoseconds.
+        uint32_t refresh;       // Refresh interval in nanoseconds. 0 if unknown.
+        uint32_t flags;         // wp_presentation_feedback_kind.
+        uint32_t missed;        // Vblanks passed between commit and presentation.
+        bool discarded;         // Frame never reached the screen.
+    };
+
+    static const uint32_t capacity = 1024;
+
+public:
+    PresentationStats();
+    ~PresentationStats();
+
+    /// Destroy feedback still in flight. Call before disconnecting the
+    /// display, the destructor does it otherwise.
+    void clear();
+
+    /// Request feedback for the next commit of the surface. Call right
+    /// before swapping or committing. Does nothing if presentation is null.
+    void frame_submitted(struct wp_presentation *presentation,
+            clockid_t clock_id, struct wl_surface *wl_surface);
+
+    /// Feedback handlers. Times are in nanoseconds of the presentation clock.
+    void frame_presented(uint64_t submitted, uint64_t presented,
+            uint32_t refresh, uint32_t flags);
+    void frame_discarded(uint64_t submitted);
+
+    /// Print latency percentiles, late, dropped and non-vsync frames.
+    void report(FILE *stream) const;
+
+    /// Install a SIGUSR1 handler which requests a report.
+    static void install_signal_handler();
+
+    /// Returns true once per received SIGUSR1.
+    static bool report_requested();
+
+private:
+    struct PendingFeedback {
+        PresentationStats *stats;
+        struct wp_presentation_feedback *feedback;
+        uint64_t submitted;
+    };
+
+    static void feedback_sync_output_handler(void *data,
+            struct wp_presentation_feedback *feedback,
+            struct wl_output *output);
+    static void feedback_presented_handler(void *data,
+            struct wp_presentation_feedback *feedback,
+            uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+            uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo,
+            uint32_t flags);
+    static void feedback_discarded_handler(void *data,
+            struct wp_presentation_feedback *feedback);
+    static const struct wp_presentation_feedback_listener feedback_listener;
+
+    void add_sample(const Sample& sample);
+    void remove_pending(PendingFeedback *pending);
+
+private:
+    Sample _samples[PresentationStats::capacity];
+    uint64_t _head;
+
+    /// Feedback not received yet, owned by this object.
+    std::vector<PendingFeedback*> _pending;
+};
+
+#endif /* _PRESENTATION_STATS_H */
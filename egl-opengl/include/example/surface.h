@@ -22,6 +22,7 @@
 
 #include <example/gl/context.h>
 #include <example/keyboard-state.h>
+#include <example/presentation-stats.h>
 
 namespace gl {
 
@@ -63,6 +64,7 @@ public:
     std::vector<gl::Object*> children() const;
 
     KeyboardState keyboard_state;
+    PresentationStats presentation_stats;
 
 private:
     Surface::Type _type;
@@ -15,7 +15,6 @@
 
 #include <glm/glm.hpp>
 
-#include <sys/time.h>
 #include <linux/input.h>
 
 #include <cairo.h>
@@ -548,10 +547,6 @@ static void move_objects()
 
 static void process_keyboard()
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    uint64_t ms = (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
-
     auto surface = app->keyboard_focus_surface();
     if (surface == nullptr) {
         return;
@@ -559,12 +554,6 @@ static void process_keyboard()
     auto& keyboard_state = surface->keyboard_state;
 
     if (keyboard_state.pressed == true) {
-        if (!keyboard_state.processed) {
-            keyboard_state.pressed_time = ms;
-            keyboard_state.elapsed_time = ms;
-        } else {
-            keyboard_state.elapsed_time = ms;
-        }
         if (keyboard_state.repeating()) {
             fprintf(stderr, "Key repeat!\n");
         }
@@ -594,9 +583,13 @@ static void process_keyboard()
             recreate_window();
         }
         keyboard_state.processed = true;
+        // One repeat per iteration, the rest are handled by the next ones.
+        if (keyboard_state.repeats > 0) {
+            keyboard_state.repeats -= 1;
+        }
     } else {
         keyboard_state.processed = false;
-        keyboard_state.pressed_time = 0;
+        keyboard_state.repeats = 0;
     }
 }
 
@@ -643,9 +636,12 @@ int main(int argc, char *argv[])
 
     create_objects();
 
+    // kill -USR1 to print presentation stats.
+    PresentationStats::install_signal_handler();
+
     surface->draw_frame(program_object);
 
-    int res = wl_display_dispatch(app->wl_display());
+    int res = app->dispatch();
     while (res != -1) {
         // Process keyboard state.
         process_keyboard();
@@ -653,9 +649,15 @@ int main(int argc, char *argv[])
         move_objects();
 
         surface->draw_frame(program_object);
-        res = wl_display_dispatch(app->wl_display());
+        res = app->dispatch();
+
+        if (PresentationStats::report_requested()) {
+            surface->presentation_stats.report(stderr);
+        }
     }
     fprintf(stderr, "wl_display_dispatch() - res: %d\n", res);
+    surface->presentation_stats.report(stderr);
+    surface->presentation_stats.clear();
 
     wl_display_disconnect(app->wl_display());
     printf("Disconnected from display.\n");
@@ -3,12 +3,15 @@
 // C
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
 
 // Wayland core
 #include <wayland-client.h>
 
 // Wayland protocols
 #include <wayland-protocols/stable/xdg-shell.h>
+#include <wayland-protocols/stable/presentation-time.h>
 
 #include <example/surface.h>
 
@@ -142,9 +145,8 @@ static void keyboard_keymap_handler(void *data, struct wl_keyboard *keyboard,
 {
     (void)data;
     (void)keyboard;
-    (void)format;
-    (void)fd;
-    (void)size;
+
+    app->keymap().set_keymap(format, fd, size);
 }
 
 static void keyboard_enter_handler(void *data, struct wl_keyboard *keyboard,
@@ -172,6 +174,8 @@ static void keyboard_leave_handler(void *data, struct wl_keyboard *keyboard,
     (void)keyboard;
     (void)serial;
     (void)surface;
+
+    app->key_repeat().stop();
 }
 
 static void keyboard_key_handler(void *data, struct wl_keyboard *keyboard,
@@ -181,7 +185,7 @@ static void keyboard_key_handler(void *data, struct wl_keyboard *keyboard,
     (void)keyboard;
     (void)serial;
     (void)time;
-    fprintf(stderr, "Key! %d\n", key);
+    fprintf(stderr, "Key! %d \"%s\"\n", key, app->keymap().utf8(key));
 
     auto surface = app->keyboard_focus_surface();
     if (surface == nullptr) {
@@ -191,9 +195,16 @@ static void keyboard_key_handler(void *data, struct wl_keyboard *keyboard,
     if (state == WL_KEYBOARD_KEY_STATE_PRESSED) {
         surface->keyboard_state.pressed = true;
         surface->keyboard_state.key = key;
+        surface->keyboard_state.processed = false;
+        surface->keyboard_state.repeats = 0;
+        if (app->keymap().key_repeats(key)) {
+            app->key_repeat().press(key);
+        }
     } else if (state == WL_KEYBOARD_KEY_STATE_RELEASED) {
-        surface->keyboard_state.pressed = false;
-        surface->keyboard_state.key = key;
+        app->key_repeat().release(key);
+        if (surface->keyboard_state.key == key) {
+            surface->keyboard_state.pressed = false;
+        }
     }
 }
 
@@ -207,10 +218,9 @@ static void keyboard_modifiers_handler(void *data, struct wl_keyboard *keyboard,
     (void)data;
     (void)keyboard;
     (void)serial;
-    (void)mods_depressed;
-    (void)mods_latched;
-    (void)mods_locked;
-    (void)group;
+
+    app->keymap().update_modifiers(mods_depressed, mods_latched, mods_locked,
+        group);
 }
 
 static void keyboard_repeat_info_handler(void *data,
@@ -225,6 +235,7 @@ static void keyboard_repeat_info_handler(void *data,
 
     app->set_keyboard_rate(rate);
     app->set_keyboard_delay(delay);
+    app->key_repeat().set_info(rate, delay);
 }
 
 static const struct wl_keyboard_listener keyboard_listener = {
@@ -289,6 +300,22 @@ static const struct xdg_wm_base_listener xdg_wm_base_listener = {
     .ping = xdg_wm_base_ping_handler,
 };
 
+//================
+// Presentation
+//================
+static void presentation_clock_id_handler(void *data,
+        struct wp_presentation *presentation, uint32_t clk_id)
+{
+    (void)data;
+    (void)presentation;
+
+    app->set_presentation_clock_id(clk_id);
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+    .clock_id = presentation_clock_id_handler,
+};
+
 //==============
 // Global
 //==============
@@ -323,6 +350,16 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
             id, &wl_seat_interface, 5);
         wl_seat_add_listener(seat, &seat_listener, NULL);
         app->set_wl_seat(seat);
+    } else if (strcmp(interface, "wp_presentation") == 0) {
+        auto presentation = (struct wp_presentation*)wl_registry_bind(
+            registry,
+            id,
+            &wp_presentation_interface,
+            1
+        );
+        wp_presentation_add_listener(presentation, &presentation_listener,
+            NULL);
+        app->set_wp_presentation(presentation);
     } else {
         printf("(%d) Got a registry event for <%s> id <%d>\n",
             version, interface, id);
@@ -358,6 +395,16 @@ Application::Application(int argc, char *argv[])
 
     this->_keyboard_focus_surface = nullptr;
 
+    this->_wp_presentation = nullptr;
+    this->_presentation_clock_id = CLOCK_MONOTONIC;
+
+    this->_key_repeat.repeat_event = [](uint32_t key) {
+        auto surface = app->keyboard_focus_surface();
+        if (surface != nullptr && surface->keyboard_state.key == key) {
+            surface->keyboard_state.repeats += 1;
+        }
+    };
+
     app = this;
 
     auto display = wl_display_connect(NULL);
@@ -388,6 +435,43 @@ Application::Application(int argc, char *argv[])
     wl_display_roundtrip(this->wl_display());
 }
 
+int Application::dispatch()
+{
+    auto display = this->_wl_display;
+
+    // Already queued events first, like wl_display_dispatch().
+    if (wl_display_prepare_read(display) != 0) {
+        return wl_display_dispatch_pending(display);
+    }
+    if (wl_display_flush(display) < 0 && errno != EAGAIN) {
+        wl_display_cancel_read(display);
+        return -1;
+    }
+
+    struct pollfd fds[2] = {
+        { wl_display_get_fd(display), POLLIN, 0 },
+        { this->_key_repeat.fd(), POLLIN, 0 },
+    };
+    int n = poll(fds, 2, -1);
+    if (n < 0) {
+        wl_display_cancel_read(display);
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    if (fds[0].revents & POLLIN) {
+        if (wl_display_read_events(display) < 0) {
+            return -1;
+        }
+    } else {
+        wl_display_cancel_read(display);
+    }
+    if (fds[1].revents & POLLIN) {
+        this->_key_repeat.dispatch();
+    }
+
+    return wl_display_dispatch_pending(display);
+}
+
 struct wl_display* Application::wl_display()
 {
     return this->_wl_display;
@@ -458,6 +542,26 @@ void Application::set_xdg_wm_base(struct xdg_wm_base *wm_base)
     this->_xdg_wm_base = wm_base;
 }
 
+struct wp_presentation* Application::wp_presentation()
+{
+    return this->_wp_presentation;
+}
+
+void Application::set_wp_presentation(struct wp_presentation *presentation)
+{
+    this->_wp_presentation = presentation;
+}
+
+clockid_t Application::presentation_clock_id() const
+{
+    return this->_presentation_clock_id;
+}
+
+void Application::set_presentation_clock_id(clockid_t clock_id)
+{
+    this->_presentation_clock_id = clock_id;
+}
+
 uint32_t Application::keyboard_rate() const
 {
     return this->_keyboard_rate;
@@ -478,6 +582,16 @@ void Application::set_keyboard_delay(uint32_t delay)
     this->_keyboard_delay = delay;
 }
 
+KeyRepeat& Application::key_repeat()
+{
+    return this->_key_repeat;
+}
+
+Keymap& Application::keymap()
+{
+    return this->_keymap;
+}
+
 void Application::add_surface(Surface *surface)
 {
     this->_surface_list.push_back(surface);
@@ -0,0 +1,100 @@
+#include <example/key-repeat.h>
+
+// C
+#include <stdio.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static void set_time(struct timespec *spec, uint64_t nanoseconds)
+{
+    spec->tv_sec = nanoseconds / 1000000000;
+    spec->tv_nsec = nanoseconds % 1000000000;
+}
+
+KeyRepeat::KeyRepeat()
+{
+    this->_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (this->_fd < 0) {
+        fprintf(stderr, "KeyRepeat - timerfd_create failed.\n");
+    }
+
+    // Defaults until repeat_info arrives.
+    this->_rate = 25;
+    this->_delay = 600;
+    this->_key = 0;
+    this->_repeating = false;
+}
+
+KeyRepeat::~KeyRepeat()
+{
+    if (this->_fd >= 0) {
+        close(this->_fd);
+    }
+}
+
+int KeyRepeat::fd() const
+{
+    return this->_fd;
+}
+
+void KeyRepeat::set_info(int32_t rate, int32_t delay)
+{
+    this->_rate = rate;
+    this->_delay = delay;
+
+    if (rate == 0) {
+        this->stop();
+    }
+}
+
+void KeyRepeat::press(uint32_t key)
+{
+    if (this->_rate <= 0 || this->_fd < 0) {
+        return;
+    }
+    this->_key = key;
+    this->_repeating = true;
+
+    struct itimerspec spec;
+    set_time(&spec.it_value, (uint64_t)this->_delay * 1000000);
+    set_time(&spec.it_interval, 1000000000 / this->_rate);
+    // Zero it_value disarms the timer.
+    if (this->_delay == 0) {
+        spec.it_value.tv_nsec = 1;
+    }
+
+    timerfd_settime(this->_fd, 0, &spec, nullptr);
+}
+
+void KeyRepeat::release(uint32_t key)
+{
+    // Releasing an earlier key keeps the latest one repeating.
+    if (this->_repeating && this->_key == key) {
+        this->stop();
+    }
+}
+
+void KeyRepeat::stop()
+{
+    this->_repeating = false;
+
+    if (this->_fd >= 0) {
+        struct itimerspec spec = {};
+        timerfd_settime(this->_fd, 0, &spec, nullptr);
+    }
+}
+
+void KeyRepeat::dispatch()
+{
+    uint64_t expirations;
+    if (read(this->_fd, &expirations, sizeof(expirations)) !=
+            sizeof(expirations)) {
+        return;
+    }
+    if (!this->_repeating || !this->repeat_event) {
+        return;
+    }
+    for (uint64_t i = 0; i < expirations; ++i) {
+        this->repeat_event(this->_key);
+    }
+}
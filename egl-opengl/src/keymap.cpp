@@ -0,0 +1,173 @@
+#include <example/keymap.h>
+
+// C
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Wayland core
+#include <wayland-client.h>
+
+// FNV-1a. Only has to tell keymaps apart, together with the size.
+static uint64_t hash_keymap(const char *data, uint32_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (uint32_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+Keymap::Keymap()
+{
+    this->_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    this->_cache_next = 0;
+
+    this->_keymap = nullptr;
+    this->_state = nullptr;
+
+    this->clear_table();
+}
+
+Keymap::~Keymap()
+{
+    if (this->_state != nullptr) {
+        xkb_state_unref(this->_state);
+    }
+    for (auto& entry: this->_cache) {
+        xkb_keymap_unref(entry.keymap);
+    }
+    xkb_context_unref(this->_context);
+}
+
+bool Keymap::set_keymap(uint32_t format, int fd, uint32_t size)
+{
+    if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1 || size == 0) {
+        close(fd);
+        return false;
+    }
+
+    auto data = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Keymap - mmap failed.\n");
+        return false;
+    }
+
+    uint64_t hash = hash_keymap(data, size);
+    struct xkb_keymap *keymap = nullptr;
+    for (auto& entry: this->_cache) {
+        if (entry.hash == hash && entry.size == size) {
+            keymap = entry.keymap;
+            break;
+        }
+    }
+
+    if (keymap == nullptr) {
+        keymap = xkb_keymap_new_from_string(this->_context, data,
+            XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
+        if (keymap == nullptr) {
+            fprintf(stderr, "Keymap - compile failed.\n");
+            munmap(data, size);
+            return false;
+        }
+
+        Entry entry = { hash, size, keymap };
+        if (this->_cache.size() < Keymap::cache_size) {
+            this->_cache.push_back(entry);
+        } else {
+            // The current keymap is never evicted.
+            if (this->_cache[this->_cache_next].keymap == this->_keymap) {
+                this->_cache_next = (this->_cache_next + 1) % Keymap::cache_size;
+            }
+            xkb_keymap_unref(this->_cache[this->_cache_next].keymap);
+            this->_cache[this->_cache_next] = entry;
+            this->_cache_next = (this->_cache_next + 1) % Keymap::cache_size;
+        }
+    }
+    munmap(data, size);
+
+    if (keymap == this->_keymap) {
+        return true;
+    }
+    if (this->_state != nullptr) {
+        xkb_state_unref(this->_state);
+    }
+    this->_keymap = keymap;
+    this->_state = xkb_state_new(keymap);
+    this->clear_table();
+
+    return true;
+}
+
+void Keymap::update_modifiers(uint32_t depressed, uint32_t latched,
+        uint32_t locked, uint32_t group)
+{
+    if (this->_state == nullptr) {
+        return;
+    }
+
+    auto changed = xkb_state_update_mask(this->_state,
+        depressed, latched, locked, 0, 0, group);
+    if (changed != 0) {
+        this->clear_table();
+    }
+}
+
+xkb_keysym_t Keymap::keysym(uint32_t key)
+{
+    return this->lookup(key).keysym;
+}
+
+const char* Keymap::utf8(uint32_t key)
+{
+    return this->lookup(key).utf8;
+}
+
+bool Keymap::key_repeats(uint32_t key) const
+{
+    if (this->_keymap == nullptr) {
+        return true;
+    }
+
+    return xkb_keymap_key_repeats(this->_keymap, key + 8) != 0;
+}
+
+const Keymap::Lookup& Keymap::lookup(uint32_t key)
+{
+    static const Lookup none = { XKB_KEY_NoSymbol, "", true };
+
+    if (this->_state == nullptr) {
+        return none;
+    }
+
+    Lookup *entry;
+    if (key < Keymap::table_size) {
+        entry = &this->_table[key];
+        if (entry->filled) {
+            return *entry;
+        }
+        entry->filled = true;
+    } else {
+        // Rare keys past the table are translated on every call.
+        entry = &this->_uncached;
+    }
+
+    // Evdev keycodes are offset by 8 in XKB.
+    xkb_keycode_t keycode = key + 8;
+    entry->keysym = xkb_state_key_get_one_sym(this->_state, keycode);
+    xkb_state_key_get_utf8(this->_state, keycode,
+        entry->utf8, sizeof(entry->utf8));
+
+    return *entry;
+}
+
+void Keymap::clear_table()
+{
+    for (auto& entry: this->_table) {
+        entry.filled = false;
+    }
+}
@@ -0,0 +1,229 @@
+#include <example/presentation-stats.h>
+
+// C
+#include <inttypes.h>
+#include <signal.h>
+
+// C++
+#include <algorithm>
+
+static volatile sig_atomic_t report_signaled = 0;
+
+static uint64_t timestamp(clockid_t clock_id)
+{
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+//=============
+// Feedback
+//=============
+
+void PresentationStats::feedback_sync_output_handler(void *data,
+        struct wp_presentation_feedback *feedback, struct wl_output *output)
+{
+    (void)data;
+    (void)feedback;
+    (void)output;
+}
+
+void PresentationStats::feedback_presented_handler(void *data,
+        struct wp_presentation_feedback *feedback,
+        uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+        uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+    auto pending = static_cast<PendingFeedback*>(data);
+    (void)feedback;
+    (void)seq_hi;
+    (void)seq_lo;
+
+    uint64_t sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo;
+    pending->stats->frame_presented(pending->submitted,
+        (sec * 1000000000) + tv_nsec, refresh, flags);
+
+    pending->stats->remove_pending(pending);
+}
+
+void PresentationStats::feedback_discarded_handler(void *data,
+        struct wp_presentation_feedback *feedback)
+{
+    auto pending = static_cast<PendingFeedback*>(data);
+    (void)feedback;
+
+    pending->stats->frame_discarded(pending->submitted);
+
+    pending->stats->remove_pending(pending);
+}
+
+const struct wp_presentation_feedback_listener
+        PresentationStats::feedback_listener = {
+    .sync_output = feedback_sync_output_handler,
+    .presented = feedback_presented_handler,
+    .discarded = feedback_discarded_handler,
+};
+
+//=====================
+// Presentation Stats
+//=====================
+
+PresentationStats::PresentationStats()
+{
+    this->_head = 0;
+}
+
+PresentationStats::~PresentationStats()
+{
+    this->clear();
+}
+
+void PresentationStats::clear()
+{
+    for (auto pending: this->_pending) {
+        wp_presentation_feedback_destroy(pending->feedback);
+        delete pending;
+    }
+    this->_pending.clear();
+}
+
+void PresentationStats::frame_submitted(struct wp_presentation *presentation,
+        clockid_t clock_id, struct wl_surface *wl_surface)
+{
+    if (presentation == nullptr) {
+        return;
+    }
+
+    auto pending = new PendingFeedback;
+    pending->stats = this;
+    pending->submitted = timestamp(clock_id);
+    pending->feedback = wp_presentation_feedback(presentation, wl_surface);
+    wp_presentation_feedback_add_listener(pending->feedback,
+        &PresentationStats::feedback_listener, pending);
+
+    this->_pending.push_back(pending);
+}
+
+void PresentationStats::frame_presented(uint64_t submitted,
+        uint64_t presented, uint32_t refresh, uint32_t flags)
+{
+    Sample sample;
+    sample.submitted = submitted;
+    sample.presented = presented;
+    sample.refresh = refresh;
+    sample.flags = flags;
+    sample.missed = 0;
+    sample.discarded = false;
+
+    // Measured against the frame's own submit time, not the previous
+    // frame, so idle gaps between repaints do not count as late. A frame
+    // shown within one refresh interval of its commit is on time.
+    if (refresh != 0 && presented > submitted) {
+        sample.missed = (presented - submitted) / refresh;
+    }
+
+    this->add_sample(sample);
+}
+
+void PresentationStats::frame_discarded(uint64_t submitted)
+{
+    Sample sample;
+    sample.submitted = submitted;
+    sample.presented = 0;
+    sample.refresh = 0;
+    sample.flags = 0;
+    sample.missed = 0;
+    sample.discarded = true;
+
+    this->add_sample(sample);
+}
+
+void PresentationStats::remove_pending(PendingFeedback *pending)
+{
+    auto it = std::find(this->_pending.begin(), this->_pending.end(),
+        pending);
+    if (it != this->_pending.end()) {
+        this->_pending.erase(it);
+    }
+
+    wp_presentation_feedback_destroy(pending->feedback);
+    delete pending;
+}
+
+void PresentationStats::add_sample(const Sample& sample)
+{
+    this->_samples[this->_head % PresentationStats::capacity] = sample;
+    this->_head += 1;
+}
+
+void PresentationStats::report(FILE *stream) const
+{
+    uint64_t head = this->_head;
+    uint64_t count = std::min<uint64_t>(head, PresentationStats::capacity);
+
+    std::vector<uint64_t> latencies;
+    uint32_t discarded = 0;
+    uint32_t late = 0;
+    uint32_t missed = 0;
+    uint32_t not_vsync = 0;
+    for (uint64_t i = head - count; i < head; ++i) {
+        const Sample& sample = this->_samples[i % PresentationStats::capacity];
+        if (sample.discarded) {
+            discarded += 1;
+            continue;
+        }
+        if (sample.presented > sample.submitted) {
+            latencies.push_back(sample.presented - sample.submitted);
+        }
+        if (sample.missed > 0) {
+            late += 1;
+            missed += sample.missed;
+        }
+        if (!(sample.flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC)) {
+            not_vsync += 1;
+        }
+    }
+
+    fprintf(stream, "Presentation stats - last %" PRIu64 " of %" PRIu64 " frames\n",
+        count, head);
+    fprintf(stream, " - discarded: %u\n", discarded);
+    fprintf(stream, " - late: %u (%u vblanks missed)\n", late, missed);
+    fprintf(stream, " - not vsync aligned: %u\n", not_vsync);
+    if (latencies.empty()) {
+        return;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](uint32_t p) {
+        return latencies[(latencies.size() - 1) * p / 100] / 1000000.0;
+    };
+    fprintf(stream, " - latency ms: p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+        percentile(50), percentile(90), percentile(99), percentile(100));
+}
+
+static void report_signal_handler(int signum)
+{
+    (void)signum;
+
+    report_signaled = 1;
+}
+
+void PresentationStats::install_signal_handler()
+{
+    struct sigaction action = {};
+    action.sa_handler = report_signal_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+
+    sigaction(SIGUSR1, &action, nullptr);
+}
+
+bool PresentationStats::report_requested()
+{
+    if (report_signaled == 0) {
+        return false;
+    }
+    report_signaled = 0;
+
+    return true;
+}
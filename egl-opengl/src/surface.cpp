@@ -96,8 +96,10 @@ Surface::Surface(Surface::Type type, uint32_t width, uint32_t height)
     this->_xdg_surface = nullptr;
     this->_xdg_toplevel = nullptr;
 
-    this->keyboard_state.rate = app->keyboard_rate();
-    this->keyboard_state.delay = app->keyboard_delay();
+    this->keyboard_state.pressed = false;
+    this->keyboard_state.key = 0;
+    this->keyboard_state.processed = false;
+    this->keyboard_state.repeats = 0;
 
     this->_context = nullptr;
 
@@ -203,6 +205,9 @@ struct xdg_toplevel* Surface::xdg_toplevel()
 void Surface::swap_buffers()
 {
     EGLBoolean result;
+    // The swap commits the surface.
+    this->presentation_stats.frame_submitted(app->wp_presentation(),
+        app->presentation_clock_id(), this->_wl_surface);
     result = eglSwapBuffers(this->_context->egl_display(), this->_egl_surface);
     if (result == EGL_FALSE) {
         fprintf(stderr, "Failed to swap buffers!\n");
@@ -1,9 +1,18 @@
 #version 460 core
 
-layout (location = 0) in vec2 point;
+// Corner of the unit quad.
+layout (location = 0) in vec2 corner;
+// Per rectangle.
+layout (location = 1) in vec4 instanceGeometry;
+layout (location = 2) in vec4 instanceColor;
+layout (location = 3) in vec4 instanceValidGeometry;
 
 uniform vec2 resolution;
 
+out vec4 color;
+flat out vec4 geometry;
+flat out vec4 validGeometry;
+
 vec2 calculateCoord(vec2 point)
 {
     float halfWidth = resolution.x / 2;
@@ -23,5 +32,10 @@ vec2 calculateCoord(vec2 point)
 
 void main()
 {
+    vec2 point = instanceGeometry.xy + (corner * instanceGeometry.zw);
     gl_Position = vec4(calculateCoord(point), 0.0, 1.0);
+
+    color = instanceColor;
+    geometry = instanceGeometry;
+    validGeometry = instanceValidGeometry;
 }
\ No newline at end of file
@@ -1,10 +1,11 @@
 #version 460 core
 precision mediump float;
 
-uniform vec4 color;
+in vec4 color;
+flat in vec4 geometry;
+flat in vec4 validGeometry;
+
 uniform vec2 resolution;
-uniform vec4 validGeometry;
-uniform vec4 geometry;
 
 out vec4 fragColor;
 
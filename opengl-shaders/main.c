@@ -1,11 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <wayland-client.h>
 #include <wayland-egl.h>
 #include <EGL/egl.h>
 
 #include <sys/time.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 
 #define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
@@ -40,7 +44,62 @@ float pos_x = 1.0f;
 float pos_y = 1.0f;
 
 
-GLuint load_shader(const char *shader_path, GLenum type)
+//==============
+// Program Cache
+//==============
+
+#define VERT_SHADER_PATH "basic_vert_shader.vert"
+#define FRAG_SHADER_PATH "color_frag_shader.frag"
+// Linked program saved by the driver, loaded instead of compiling.
+#define PROGRAM_BINARY_PATH "program.bin"
+
+// The linked program is built once and only rebuilt when a shader file
+// in the working directory changes.
+struct program_cache {
+    // Hash of the shader sources and the GL driver. A saved binary is
+    // only used if it was saved with the same key.
+    uint64_t key;
+    // inotify on the working directory. -1 if not available.
+    int inotify_fd;
+    int stale;
+};
+
+struct program_cache program_cache = { 0, -1, 1 };
+
+static char* read_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Can't open %s.\n", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    rewind(f);
+
+    char *source = malloc(file_size + 1);
+    size_t read = fread(source, 1, file_size, f);
+    source[read] = '\0';
+
+    fclose(f);
+
+    return source;
+}
+
+// FNV-1a.
+static uint64_t hash_string(uint64_t hash, const char *str)
+{
+    if (str == NULL) {
+        return hash;
+    }
+    for (; *str != '\0'; ++str) {
+        hash ^= (unsigned char)*str;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+GLuint load_shader(const char *source, GLenum type)
 {
     GLuint shader;
     GLint compiled;
@@ -51,23 +110,8 @@ GLuint load_shader(const char *shader_path, GLenum type)
         return 0;
     }
 
-    char *shader_s;
-    // Read shader from source.
-    {
-        FILE *f = fopen(shader_path, "r");
-        fseek(f, 0, SEEK_END);
-        long file_size = ftell(f);
-        rewind(f);
-
-        shader_s = malloc(file_size + 1);
-        fread(shader_s, 1, file_size, f);
-        shader_s[file_size] = '\0';
-
-        fclose(f);
-    }
-
     // Load the shader source.
-    glShaderSource(shader, 1, (const char**)&shader_s, NULL);
+    glShaderSource(shader, 1, &source, NULL);
 
     // Compile the shader.
     glCompileShader(shader);
@@ -79,7 +123,9 @@ GLuint load_shader(const char *shader_path, GLenum type)
 
         glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_len);
         if (info_len > 1) {
-            char *info_log = malloc(sizeof(char));
+            char *info_log = malloc(sizeof(char) * info_len);
+
+            glGetShaderInfoLog(shader, info_len, NULL, info_log);
             fprintf(stderr, "Error compiling shader: %s\n", info_log);
             free(info_log);
         }
@@ -91,13 +137,21 @@ GLuint load_shader(const char *shader_path, GLenum type)
     return shader;
 }
 
-void program_shaders(GLuint program, GLuint vert_shader, GLuint frag_shader)
+GLuint program_shaders(GLuint vert_shader, GLuint frag_shader)
 {
+    GLuint program = glCreateProgram();
+
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+        GL_TRUE);
     glAttachShader(program, vert_shader);
     glAttachShader(program, frag_shader);
 
     glLinkProgram(program);
 
+    // The program keeps what it needs.
+    glDetachShader(program, vert_shader);
+    glDetachShader(program, frag_shader);
+
     // Check the link status.
     GLint linked;
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
@@ -113,170 +167,391 @@ void program_shaders(GLuint program, GLuint vert_shader, GLuint frag_shader)
         }
 
         glDeleteProgram(program);
+        return 0;
     }
+
+    return program;
 }
 
-void set_vert_uniforms(GLuint program)
+static GLuint load_program_binary(uint64_t key)
 {
-    GLuint pos = glGetUniformLocation(program, "resolution");
-    float resolution[2] = { (float)window_width, (float)window_height };
-    glUniform2fv(pos, 1, resolution);
+    FILE *f = fopen(PROGRAM_BINARY_PATH, "r");
+    if (f == NULL) {
+        return 0;
+    }
+
+    uint64_t saved_key;
+    GLenum format;
+    GLint length;
+    if (fread(&saved_key, sizeof(saved_key), 1, f) != 1 ||
+            fread(&format, sizeof(format), 1, f) != 1 ||
+            fread(&length, sizeof(length), 1, f) != 1 ||
+            saved_key != key || length <= 0) {
+        fclose(f);
+        return 0;
+    }
+
+    void *binary = malloc(length);
+    GLuint program = 0;
+    if (fread(binary, length, 1, f) == 1) {
+        program = glCreateProgram();
+        glProgramBinary(program, format, binary, length);
+
+        // Drivers reject binaries of other versions.
+        GLint linked;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    free(binary);
+    fclose(f);
+
+    return program;
 }
 
-void set_uniform_color(GLuint program, float *color)
+static void save_program_binary(GLuint program, uint64_t key)
 {
-    GLuint pos = glGetUniformLocation(program, "color");
-    float col[4] = { color[0], color[1], color[2], color[3] };
-    glUniform4fv(pos, 1, col);
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    void *binary = malloc(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary);
+
+    FILE *f = fopen(PROGRAM_BINARY_PATH, "w");
+    if (f != NULL) {
+        fwrite(&key, sizeof(key), 1, f);
+        fwrite(&format, sizeof(format), 1, f);
+        fwrite(&length, sizeof(length), 1, f);
+        fwrite(binary, length, 1, f);
+        fclose(f);
+    }
+    free(binary);
 }
 
-void set_uniform_validGeometry(GLuint program,
-                               float x,
-                               float y,
-                               float width,
-                               float height)
+// Build program_object from the shader files. The old program is kept if
+// the new sources fail, so a broken edit does not blank the window.
+static void build_program()
 {
-    GLuint pos = glGetUniformLocation(program, "validGeometry");
-    float geo[4] = { x, y, width, height };
-    glUniform4fv(pos, 1, geo);
+    program_cache.stale = 0;
+
+    char *vert_source = read_file(VERT_SHADER_PATH);
+    char *frag_source = read_file(FRAG_SHADER_PATH);
+    if (vert_source == NULL || frag_source == NULL) {
+        free(vert_source);
+        free(frag_source);
+        return;
+    }
+
+    uint64_t key = 0xcbf29ce484222325;
+    key = hash_string(key, vert_source);
+    key = hash_string(key, frag_source);
+    key = hash_string(key, (const char*)glGetString(GL_VENDOR));
+    key = hash_string(key, (const char*)glGetString(GL_RENDERER));
+    key = hash_string(key, (const char*)glGetString(GL_VERSION));
+
+    GLuint program = 0;
+    if (key == program_cache.key && program_object != 0) {
+        // Touched but not changed.
+        program = program_object;
+    } else {
+        program = load_program_binary(key);
+    }
+
+    if (program == 0) {
+        fprintf(stderr, "Compiling shaders.\n");
+        GLuint vert_shader = load_shader(vert_source, GL_VERTEX_SHADER);
+        GLuint frag_shader = load_shader(frag_source, GL_FRAGMENT_SHADER);
+        if (vert_shader != 0 && frag_shader != 0) {
+            program = program_shaders(vert_shader, frag_shader);
+        }
+        glDeleteShader(vert_shader);
+        glDeleteShader(frag_shader);
+
+        if (program != 0) {
+            save_program_binary(program, key);
+        }
+    }
+    free(vert_source);
+    free(frag_source);
+
+    if (program != 0 && program != program_object) {
+        if (program_object != 0) {
+            glDeleteProgram(program_object);
+        }
+        program_object = program;
+        program_cache.key = key;
+    }
 }
 
-void set_uniform_geometry(GLuint program,
-                          float x,
-                          float y,
-                          float width,
-                          float height)
+// Hot reload. Marks the program stale when an editor writes a shader file.
+static void check_shader_files()
 {
-    GLuint pos = glGetUniformLocation(program, "geometry");
-    float geo[4] = { x, y, width, height };
-    glUniform4fv(pos, 1, geo);
+    if (program_cache.inotify_fd < 0) {
+        return;
+    }
+
+    char events[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(program_cache.inotify_fd, events, sizeof(events))) > 0) {
+        for (char *it = events; it < events + len;
+                it += sizeof(struct inotify_event) +
+                    ((struct inotify_event*)it)->len) {
+            const struct inotify_event *event = (struct inotify_event*)it;
+            if (event->len > 0 &&
+                    (strcmp(event->name, VERT_SHADER_PATH) == 0 ||
+                    strcmp(event->name, FRAG_SHADER_PATH) == 0)) {
+                program_cache.stale = 1;
+            }
+        }
+    }
 }
 
-void calc_points(float x, float y, float width, float height, float *points)
+void init_program_cache()
 {
-    float half_width = window_width / 2;
-    float half_height = window_height / 2;
-
-    // Top-left
-    points[0] = x;
-    points[1] = y;
-    // Bottom-left
-    points[3] = x;
-    points[4] = y + height;
-    // Bottom-right
-    points[6] = x + width;
-    points[7] = y + height;
-    // Top-right
-    points[9] = x + width;
-    points[10] = y;
+    // Editors often replace the file, so watch the directory.
+    program_cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (program_cache.inotify_fd >= 0 &&
+            inotify_add_watch(program_cache.inotify_fd, ".",
+                IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(program_cache.inotify_fd);
+        program_cache.inotify_fd = -1;
+    }
+
+    build_program();
 }
 
-void draw_frame()
+// Current program. Needs the context to be current.
+GLuint use_program_cache()
 {
-    GLfloat vVertices[] = {
-        0.0f, 0.5f, 0.0f,   // top left
-        -0.5f, -0.5f, 0.0f, // bottom left
-        0.5f, -0.5f, 0.0f,  // bottom right
-        0.5f, 0.5f, 0.0f,   // top right
-    };
-    GLuint indices[] = {
-        0, 1, 3,        // Top left, bottom left, bottom right
-        // 3, 2, 1,
-        1, 2, 3,        // Bottom left, top right, bottom right
-    };
+    check_shader_files();
+    if (program_cache.stale) {
+        build_program();
+    }
 
-    fprintf(stderr, "Draw frame.\n");
+    return program_object;
+}
 
-    GLuint vert_shader;
-    GLuint frag_shader;
-    vert_shader = load_shader("basic_vert_shader.vert", GL_VERTEX_SHADER);
-    frag_shader = load_shader("color_frag_shader.frag", GL_FRAGMENT_SHADER);
-    program_shaders(program_object, vert_shader, frag_shader);
+//==============
+// GL State
+//==============
 
-    eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context);
+// Last state set on the context. Setters skip calls that change nothing.
+struct gl_state {
+    GLuint program;
+    GLuint vao;
+    int blend;
+    // Uniform locations, resolved once per linked program.
+    GLuint uniforms_program;
+    GLint resolution_location;
+    float resolution[2];
+};
 
-    // Set the viewport.
-    glViewport(0, 0, window_width, window_height);
+struct gl_state gl_state = { 0, };
 
-    // Clear the color buffer.
-    glClearColor(1.0, 0.0, 0.0, 0.8);
-    // Blend.
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void gl_use_program(GLuint program)
+{
+    if (gl_state.program != program) {
+        glUseProgram(program);
+        gl_state.program = program;
+    }
+}
 
-    glClear(GL_COLOR_BUFFER_BIT);
-    // Use the program object.
-    glUseProgram(program_object);
-    set_vert_uniforms(program_object);
+void gl_bind_vertex_array(GLuint vao)
+{
+    if (gl_state.vao != vao) {
+        glBindVertexArray(vao);
+        gl_state.vao = vao;
+    }
+}
+
+void gl_set_blend(int enabled)
+{
+    if (gl_state.blend == enabled) {
+        return;
+    }
+    if (enabled) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    } else {
+        glDisable(GL_BLEND);
+    }
+    gl_state.blend = enabled;
+}
+
+void set_vert_uniforms(GLuint program)
+{
+    if (gl_state.uniforms_program != program) {
+        gl_state.uniforms_program = program;
+        gl_state.resolution_location =
+            glGetUniformLocation(program, "resolution");
+        // Not uploaded to this program yet.
+        gl_state.resolution[0] = -1.0f;
+    }
+
+    if (gl_state.resolution[0] == (float)window_width &&
+            gl_state.resolution[1] == (float)window_height) {
+        return;
+    }
+    gl_state.resolution[0] = (float)window_width;
+    gl_state.resolution[1] = (float)window_height;
+    glUniform2fv(gl_state.resolution_location, 1, gl_state.resolution);
+}
 
+//==============
+// Rectangles
+//==============
 
-   float color[] = { 1.0f, 0.0f, 0.0f, 0.9f };
+#define MAX_RECTS 256
 
-    // VAO.
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
+// Instance attributes of a rectangle. Locations 1 to 3 of the vertex
+// shader.
+struct rect_instance {
+    float geometry[4];
+    float color[4];
+    // Clip rectangle. All zero for no clipping.
+    float valid_geometry[4];
+};
 
-    // EBO.
+// Rectangles queued for one instanced draw.
+struct rect_batch {
+    GLuint vao;
+    GLuint quad_vbo;
     GLuint ebo;
-    glGenBuffers(1, &ebo);
+    GLuint instance_vbo;
+    struct rect_instance rects[MAX_RECTS];
+    int length;
+};
 
-    // VBO.
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
+struct rect_batch rect_batch = { 0, };
 
+static void init_rect_batch()
+{
+    // Unit quad, scaled and moved by the instance geometry.
+    static const GLfloat corners[] = {
+        0.0f, 0.0f,     // top left
+        0.0f, 1.0f,     // bottom left
+        1.0f, 1.0f,     // bottom right
+        1.0f, 0.0f,     // top right
+    };
+    static const GLuint indices[] = {
+        0, 1, 3,
+        1, 2, 3,
+    };
 
-    // 1st Rectangle.
-    glBindVertexArray(vao);
+    glGenVertexArrays(1, &rect_batch.vao);
+    gl_bind_vertex_array(rect_batch.vao);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glGenBuffers(1, &rect_batch.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rect_batch.ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
         GL_STATIC_DRAW);
 
-    calc_points(10.0f, 10.0f, 100.0f, 100.0f, vVertices);
+    glGenBuffers(1, &rect_batch.quad_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, rect_batch.quad_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-        sizeof(vVertices),
-        vVertices,
-        GL_STATIC_DRAW
-    );
+    glGenBuffers(1, &rect_batch.instance_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, rect_batch.instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(rect_batch.rects), NULL,
+        GL_STREAM_DRAW);
+
+    const GLsizei stride = sizeof(struct rect_instance);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride,
+        (void*)offsetof(struct rect_instance, geometry));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
+        (void*)offsetof(struct rect_instance, color));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride,
+        (void*)offsetof(struct rect_instance, valid_geometry));
+    for (GLuint i = 1; i <= 3; ++i) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glEnableVertexAttribArray(0);
+// Draw all queued rectangles with a single call.
+void flush_rects()
+{
+    if (rect_batch.length == 0) {
+        return;
+    }
 
-    set_uniform_color(program_object, color);
+    gl_bind_vertex_array(rect_batch.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, rect_batch.instance_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+        sizeof(struct rect_instance) * rect_batch.length, rect_batch.rects);
 
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0,
+        rect_batch.length);
+    rect_batch.length = 0;
+}
 
+// Queue a rectangle. valid_geometry may be NULL for no clipping.
+void add_rect(float x, float y, float width, float height,
+        const float *color, const float *valid_geometry)
+{
+    if (rect_batch.length == MAX_RECTS) {
+        flush_rects();
+    }
 
-    // 2nd Rectangle.
-    glBindVertexArray(vao);
+    struct rect_instance *rect = &rect_batch.rects[rect_batch.length];
+    rect->geometry[0] = x;
+    rect->geometry[1] = y;
+    rect->geometry[2] = width;
+    rect->geometry[3] = height;
+    for (int i = 0; i < 4; ++i) {
+        rect->color[i] = color[i];
+        rect->valid_geometry[i] =
+            (valid_geometry != NULL) ? valid_geometry[i] : 0.0f;
+    }
+    rect_batch.length += 1;
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-        GL_STATIC_DRAW);
+void draw_frame()
+{
+    fprintf(stderr, "Draw frame.\n");
 
-    calc_points(30.0f, 30.0f, 300.0f, 300.0f, vVertices);
+    eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context);
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-        sizeof(vVertices),
-        vVertices,
-        GL_STATIC_DRAW
-    );
+    // Compiled once, rebuilt only when a shader file changed.
+    if (use_program_cache() == 0) {
+        return;
+    }
+    if (rect_batch.vao == 0) {
+        init_rect_batch();
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glEnableVertexAttribArray(0);
+    // Set the viewport.
+    glViewport(0, 0, window_width, window_height);
+
+    // Clear the color buffer.
+    glClearColor(1.0, 0.0, 0.0, 0.8);
+    // Blend.
+    gl_set_blend(1);
 
-    color[0] = 0.0f;
-    color[1] = 1.0f;
-    color[2] = 0.0f;
-    color[3] = 0.5f;
-    set_uniform_color(program_object, color);
-    set_uniform_validGeometry(program_object, 10.0f, 10.0f, 100.0f, 100.0f);
-    set_uniform_geometry(program_object, 30.0f, 30.0f, 300.0f, 300.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    // Use the program object.
+    gl_use_program(program_object);
+    set_vert_uniforms(program_object);
 
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
+    // 1st Rectangle.
+    const float color[] = { 1.0f, 0.0f, 0.0f, 0.9f };
+    add_rect(10.0f, 10.0f, 100.0f, 100.0f, color, NULL);
+
+    // 2nd Rectangle, clipped to the 1st.
+    const float color2[] = { 0.0f, 1.0f, 0.0f, 0.5f };
+    const float valid_geometry[] = { 10.0f, 10.0f, 100.0f, 100.0f };
+    add_rect(30.0f, 30.0f, 300.0f, 300.0f, color2, valid_geometry);
+
+    flush_rects();
 
     struct timeval start;
     gettimeofday(&start, NULL);
@@ -287,10 +562,6 @@ void draw_frame()
     gettimeofday(&end, NULL);
     fprintf(stderr, "[%f] eglSwapBuffers\n",
         (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0);
-
-    // Clean up.
-    glDetachShader(program_object, vert_shader);
-    glDetachShader(program_object, frag_shader);
 }
 
 //===========
@@ -620,9 +891,9 @@ int main(int argc, char *argv[])
     init_egl();
     create_window();
 
-    program_object = glCreateProgram();
+    init_program_cache();
     if (program_object == 0) {
-        fprintf(stderr, "glCreateProgram() - program_object is 0\n");
+        fprintf(stderr, "init_program_cache() - program_object is 0\n");
         return 0;
     }
 
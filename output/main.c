@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <poll.h>
 #include <wayland-client.h>
 #include <wayland-egl.h>
 #include <EGL/egl.h>
@@ -9,14 +12,20 @@
 #include <cairo.h>
 
 #include "xdg-shell.h"
+#include "presentation-time.h"
+
+#define WINDOW_WIDTH 480
+#define WINDOW_HEIGHT 360
 
 struct wl_display *display = NULL;
 struct wl_compositor *compositor = NULL;
 struct wl_subcompositor *subcompositor = NULL;
 struct wl_surface *surface;
-struct wl_egl_window *egl_window;
+struct wl_egl_window *egl_window = NULL;
+// Scale of the buffers attached to surface.
+int32_t buffer_scale = 1;
 struct wl_region *region;
-struct wl_output *output;
+struct wp_presentation *presentation = NULL;
 
 struct xdg_wm_base *xdg_wm_base = NULL;
 struct xdg_surface *xdg_surface = NULL;
@@ -38,6 +47,224 @@ struct wl_egl_window *egl_window2;
 EGLSurface egl_surface2;
 struct wl_subsurface *subsurface;
 
+//==============
+// Frame Pacing
+//==============
+
+// Time left for the compositor to composite after our frame is submitted.
+#define PACING_SAFETY_MARGIN 3000000
+#define MAX_SURFACE_OUTPUTS 8
+
+struct output {
+    struct wl_output *wl_output;
+    uint32_t id;
+    // Refresh rate of the current mode in mHz. 0 if unknown.
+    int32_t refresh;
+    int32_t scale;
+    struct output *next;
+};
+
+struct output *outputs = NULL;
+
+// Renders at most one frame per vblank, started as late as the last
+// render time allows, so input is sampled as close to scanout as possible.
+struct frame_pacer {
+    // Clock of the presentation timestamps.
+    clockid_t clock_id;
+    // Outputs the toplevel surface is on.
+    struct output *outputs[MAX_SURFACE_OUTPUTS];
+    int outputs_length;
+    // Nanoseconds between vblanks reported by presentation feedback.
+    // 0 if unknown, then the output mode is used.
+    uint64_t presented_refresh;
+    // Timestamp of the last presented frame. 0 if none yet.
+    uint64_t last_presented;
+    // Vblank the last frame was rendered for.
+    uint64_t target_vblank;
+    // Average time to render and submit a frame.
+    uint64_t render_time;
+    int needs_redraw;
+};
+
+struct frame_pacer pacer = {
+    .clock_id = CLOCK_MONOTONIC,
+    .outputs_length = 0,
+    .presented_refresh = 0,
+    .last_presented = 0,
+    .target_vblank = 0,
+    .render_time = 0,
+    .needs_redraw = 1,
+};
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+
+    clock_gettime(pacer.clock_id, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+static uint64_t refresh_interval()
+{
+    if (pacer.presented_refresh != 0) {
+        return pacer.presented_refresh;
+    }
+
+    // The fastest output the surface is on.
+    int32_t refresh = 0;
+    for (int i = 0; i < pacer.outputs_length; ++i) {
+        if (pacer.outputs[i]->refresh > refresh) {
+            refresh = pacer.outputs[i]->refresh;
+        }
+    }
+    if (refresh == 0) {
+        refresh = 60000;
+    }
+
+    return 1000000000000 / refresh;
+}
+
+// First vblank after now not rendered for yet.
+static uint64_t next_vblank(uint64_t now)
+{
+    if (pacer.last_presented == 0) {
+        return now;
+    }
+
+    uint64_t interval = refresh_interval();
+    uint64_t vblank = pacer.last_presented;
+    if (now > vblank) {
+        vblank += ((now - vblank) / interval + 1) * interval;
+    }
+    while (vblank <= pacer.target_vblank) {
+        vblank += interval;
+    }
+
+    return vblank;
+}
+
+// When rendering has to start to make the next vblank.
+static uint64_t render_deadline(uint64_t now)
+{
+    uint64_t vblank = next_vblank(now);
+    uint64_t budget = pacer.render_time + PACING_SAFETY_MARGIN;
+
+    return (vblank > budget) ? vblank - budget : 0;
+}
+
+static void feedback_sync_output_handler(void *data,
+        struct wp_presentation_feedback *feedback, struct wl_output *output)
+{
+    (void)data;
+    (void)feedback;
+    (void)output;
+}
+
+static void feedback_presented_handler(void *data,
+        struct wp_presentation_feedback *feedback,
+        uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+        uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+    (void)data;
+
+    uint64_t sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo;
+    pacer.last_presented = (sec * 1000000000) + tv_nsec;
+    pacer.presented_refresh = refresh;
+
+    wp_presentation_feedback_destroy(feedback);
+}
+
+static void feedback_discarded_handler(void *data,
+        struct wp_presentation_feedback *feedback)
+{
+    (void)data;
+
+    wp_presentation_feedback_destroy(feedback);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+    .sync_output = feedback_sync_output_handler,
+    .presented = feedback_presented_handler,
+    .discarded = feedback_discarded_handler,
+};
+
+static void presentation_clock_id_handler(void *data,
+        struct wp_presentation *presentation, uint32_t clk_id)
+{
+    (void)data;
+    (void)presentation;
+
+    pacer.clock_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+    .clock_id = presentation_clock_id_handler,
+};
+
+//==============
+// Buffer Scale
+//==============
+
+// Matches the buffer to the highest scale of the outputs the surface is on.
+// The EGL surface and program are kept; only the window is resized and
+// both changes take effect with the next swap.
+static void update_buffer_scale()
+{
+    int32_t scale = 1;
+    for (int i = 0; i < pacer.outputs_length; ++i) {
+        if (pacer.outputs[i]->scale > scale) {
+            scale = pacer.outputs[i]->scale;
+        }
+    }
+
+    if (scale == buffer_scale || egl_window == NULL) {
+        return;
+    }
+    fprintf(stderr, "update_buffer_scale() - %d -> %d\n", buffer_scale, scale);
+    buffer_scale = scale;
+
+    wl_egl_window_resize(egl_window,
+        WINDOW_WIDTH * scale, WINDOW_HEIGHT * scale, 0, 0);
+    wl_surface_set_buffer_scale(surface, scale);
+    pacer.needs_redraw = 1;
+}
+
+static void surface_enter_handler(void *data,
+        struct wl_surface *wl_surface, struct wl_output *wl_output)
+{
+    struct output *output = wl_output_get_user_data(wl_output);
+
+    if (output == NULL || pacer.outputs_length == MAX_SURFACE_OUTPUTS) {
+        return;
+    }
+    pacer.outputs[pacer.outputs_length] = output;
+    pacer.outputs_length += 1;
+
+    update_buffer_scale();
+}
+
+static void surface_leave_handler(void *data,
+        struct wl_surface *wl_surface, struct wl_output *wl_output)
+{
+    struct output *output = wl_output_get_user_data(wl_output);
+
+    for (int i = 0; i < pacer.outputs_length; ++i) {
+        if (pacer.outputs[i] == output) {
+            pacer.outputs_length -= 1;
+            pacer.outputs[i] = pacer.outputs[pacer.outputs_length];
+            break;
+        }
+    }
+
+    update_buffer_scale();
+}
+
+static const struct wl_surface_listener surface_listener = {
+    .enter = surface_enter_handler,
+    .leave = surface_leave_handler,
+};
+
 uint32_t image_width;
 uint32_t image_height;
 uint32_t image_size;
@@ -181,10 +408,14 @@ int init(GLuint *program_object)
 }
 
 //===========
-// XDG
+// Drawing
 //===========
-static void xdg_wm_base_ping_handler(void *data,
-        struct xdg_wm_base *xdg_wm_base, uint32_t serial)
+
+// Geometry and texture, uploaded once.
+GLuint scene_vao = 0;
+GLuint scene_texture = 0;
+
+static void init_scene()
 {
     GLfloat vVertices[] = {
          1.0f,  1.0f,  0.0f,    1.0f, 0.0f, 0.0f,   1.0f, 1.0f,     // top right
@@ -203,21 +434,8 @@ static void xdg_wm_base_ping_handler(void *data,
         1, 2, 3,    // second triangle
     };
 
-    eglMakeCurrent(egl_object.egl_display, egl_object.egl_surface,
-        egl_object.egl_surface, egl_object.egl_context);
-
-    // Set the viewport.
-    glViewport(0, 0, 128, 128);
-
-    // Clear the color buffer.
-    glClearColor(0.0, 0.0, 0.0, 0.8f);
-    glClear(GL_COLOR_BUFFER_BIT);
-    // Use the program object.
-    glUseProgram(egl_object2.program_object);
-
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    glGenVertexArrays(1, &scene_vao);
+    glBindVertexArray(scene_vao);
 
     GLuint ebo;
     glGenBuffers(1, &ebo);
@@ -244,12 +462,8 @@ static void xdg_wm_base_ping_handler(void *data,
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (void*)0);
     glEnableVertexAttribArray(2);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    glGenTextures(1, &scene_texture);
+    glBindTexture(GL_TEXTURE_2D, scene_texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -266,13 +480,59 @@ static void xdg_wm_base_ping_handler(void *data,
         image_data
     );
     glGenerateMipmap(GL_TEXTURE_2D);
+}
 
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glBindVertexArray(vao);
+static void draw_frame()
+{
+    uint64_t start = now_ns();
+    pacer.target_vblank = next_vblank(start);
+    pacer.needs_redraw = 0;
+
+    eglMakeCurrent(egl_object.egl_display, egl_object.egl_surface,
+        egl_object.egl_surface, egl_object.egl_context);
+
+    if (scene_vao == 0) {
+        init_scene();
+    }
+
+    // Set the viewport.
+    glViewport(0, 0, 128 * buffer_scale, 128 * buffer_scale);
+
+    // Clear the color buffer.
+    glClearColor(0.0, 0.0, 0.0, 0.8f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    // Use the program object.
+    glUseProgram(egl_object2.program_object);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glBindTexture(GL_TEXTURE_2D, scene_texture);
+    glBindVertexArray(scene_vao);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
 
+    // Ask when the frame reaches the screen. The swap commits.
+    if (presentation != NULL) {
+        struct wp_presentation_feedback *feedback =
+            wp_presentation_feedback(presentation, surface);
+        wp_presentation_feedback_add_listener(feedback,
+            &feedback_listener, NULL);
+    }
     eglSwapBuffers(egl_object.egl_display, egl_object.egl_surface);
 
+    // Moving average of the render time.
+    uint64_t elapsed = now_ns() - start;
+    pacer.render_time = (pacer.render_time * 7 + elapsed) / 8;
+}
+
+//===========
+// XDG
+//===========
+static void xdg_wm_base_ping_handler(void *data,
+        struct xdg_wm_base *xdg_wm_base, uint32_t serial)
+{
+    pacer.needs_redraw = 1;
+
     xdg_wm_base_pong(xdg_wm_base, serial);
 }
 
@@ -328,11 +588,16 @@ static void output_geometry_handler(void *data,
 }
 
 static void output_mode_handler(void *data,
-        struct wl_output *output, uint32_t flags,
+        struct wl_output *wl_output, uint32_t flags,
         int32_t width, int32_t height, int32_t refresh)
 {
-    (void)data;
-    (void)output;
+    struct output *output = (struct output*)data;
+
+    if (flags & WL_OUTPUT_MODE_CURRENT) {
+        fprintf(stderr, "output_mode_handler() - %dx%d@%d mHz\n",
+            width, height, refresh);
+        output->refresh = refresh;
+    }
 }
 
 static void output_done_handler(void *data,
@@ -340,14 +605,18 @@ static void output_done_handler(void *data,
 {
     (void)data;
     (void)output;
+
+    // The scale of an output the surface is on may have changed.
+    update_buffer_scale();
 }
 
 static void output_scale_handler(void *data,
-        struct wl_output *output, int32_t scale)
+        struct wl_output *wl_output, int32_t scale)
 {
-    (void)data;
+    struct output *output = (struct output*)data;
 
-    fprintf(stderr, "output_scale_handler() - output: %p, scale: %d\n", output, scale);
+    fprintf(stderr, "output_scale_handler() - output: %p, scale: %d\n", wl_output, scale);
+    output->scale = scale;
 }
 
 static void output_name_handler(void *data,
@@ -398,9 +667,20 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
             id, &wl_subcompositor_interface, 1);
     } else if (strcmp(interface, "wl_output") == 0) {
         fprintf(stderr, "Interface is <wl_output> v%d\n", version);
-        output = wl_registry_bind(registry,
+        struct output *output = malloc(sizeof(struct output));
+        output->wl_output = wl_registry_bind(registry,
             id, &wl_output_interface, 2);
-        wl_output_add_listener(output, &output_listener, NULL);
+        output->id = id;
+        output->refresh = 0;
+        output->scale = 1;
+        output->next = outputs;
+        outputs = output;
+        wl_output_add_listener(output->wl_output, &output_listener, output);
+    } else if (strcmp(interface, "wp_presentation") == 0) {
+        presentation = wl_registry_bind(registry,
+            id, &wp_presentation_interface, 1);
+        wp_presentation_add_listener(presentation,
+            &presentation_listener, NULL);
     } else {
         printf("(%d) Got a registry event for <%s> id <%d>\n",
             version, interface, id);
@@ -411,6 +691,19 @@ static void global_registry_remover(void *data, struct wl_registry *registry,
         uint32_t id)
 {
     printf("Got a registry losing event for <%d>\n", id);
+
+    for (struct output **it = &outputs; *it != NULL; it = &(*it)->next) {
+        struct output *output = *it;
+        if (output->id != id) {
+            continue;
+        }
+        // Forget it on the surface as well.
+        surface_leave_handler(NULL, surface, output->wl_output);
+        *it = output->next;
+        wl_output_destroy(output->wl_output);
+        free(output);
+        break;
+    }
 }
 
 static const struct wl_registry_listener registry_listener = {
@@ -420,7 +713,7 @@ static const struct wl_registry_listener registry_listener = {
 
 static void create_window()
 {
-    egl_window = wl_egl_window_create(surface, 480, 360);
+    egl_window = wl_egl_window_create(surface, WINDOW_WIDTH, WINDOW_HEIGHT);
     if (egl_window == EGL_NO_SURFACE) {
         fprintf(stderr, "Can't create egl window.\n");
         exit(1);
@@ -573,6 +866,7 @@ int main(int argc, char *argv[])
     } else {
         fprintf(stderr, "Created surface!\n");
     }
+    wl_surface_add_listener(surface, &surface_listener, NULL);
     surface2 = wl_compositor_create_surface(compositor);
     subsurface = wl_subcompositor_get_subsurface(subcompositor,
         surface2, surface);
@@ -582,7 +876,7 @@ int main(int argc, char *argv[])
 
     // Output.
     fprintf(stderr, " - Checking output...\n");
-    if (output == NULL) {
+    if (outputs == NULL) {
         fprintf(stderr, "Output is NULL!\n");
         exit(1);
     }
@@ -625,11 +919,45 @@ int main(int argc, char *argv[])
 
     fprintf(stderr, "program. first: %d, second: %d\n", egl_object.program_object, egl_object2.program_object);
 
+    // Frames are paced by the loop below, not by blocking in the swap.
+    eglMakeCurrent(egl_object.egl_display, egl_object.egl_surface,
+        egl_object.egl_surface, egl_object.egl_context);
+    eglSwapInterval(egl_object.egl_display, 0);
+
 //    wl_surface_commit(surface);
 
-    int res = wl_display_dispatch(display);
+    int res = 0;
     while (res != -1) {
-        res = wl_display_dispatch(display);
+        while (wl_display_prepare_read(display) != 0) {
+            wl_display_dispatch_pending(display);
+        }
+        wl_display_flush(display);
+
+        // Sleep until events arrive or it is time to render.
+        int timeout = -1;
+        if (pacer.needs_redraw) {
+            uint64_t now = now_ns();
+            uint64_t deadline = render_deadline(now);
+            // Round up, truncating would spin on a zero timeout for the
+            // last fraction of a millisecond.
+            timeout = (deadline > now)
+                ? (deadline - now + 999999) / 1000000
+                : 0;
+        }
+
+        struct pollfd fd = { wl_display_get_fd(display), POLLIN, 0 };
+        if (poll(&fd, 1, timeout) > 0 && (fd.revents & POLLIN)) {
+            res = wl_display_read_events(display);
+        } else {
+            wl_display_cancel_read(display);
+        }
+        if (res != -1) {
+            res = wl_display_dispatch_pending(display);
+        }
+
+        if (pacer.needs_redraw && now_ns() >= render_deadline(now_ns())) {
+            draw_frame();
+        }
     }
     fprintf(stderr, "wl_display_dispatch() - res: %d\n", res);
 
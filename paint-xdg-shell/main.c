@@ -199,10 +199,20 @@ static struct wl_buffer* create_buffer()
     return buff;
 }
 
+// Pixels are painted fully opaque, no blending needed below them.
+static void set_opaque_region(struct wl_surface *wl_surface)
+{
+    struct wl_region *region = wl_compositor_create_region(compositor);
+    wl_region_add(region, 0, 0, WIDTH, HEIGHT);
+    wl_surface_set_opaque_region(wl_surface, region);
+    wl_region_destroy(region);
+}
+
 static void create_window()
 {
     buffer = create_buffer();
 
+    set_opaque_region(surface);
     wl_surface_attach(surface, buffer, 0, 0);
     // wl_surface_damage(surface, 0, 0, WIDTH, HEIGHT);
     wl_surface_commit(surface);
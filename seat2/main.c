@@ -7,6 +7,9 @@
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
 #include <linux/input.h>
+#include <xkbcommon/xkbcommon.h>
+#include <poll.h>
+#include <sys/timerfd.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
@@ -52,12 +55,233 @@ EGLConfig egl_conf;
 EGLSurface egl_surface;
 EGLContext egl_context;
 
+//============
+// Keymap
+//============
+
+// Compiled keymaps are cached by content hash, the compositor re-sends the
+// same keymap on reconnect and seat changes. Translations for the current
+// modifiers are kept in a table indexed by evdev keycode.
+#define KEYMAP_CACHE_SIZE 4
+#define KEY_TABLE_SIZE 256
+
+struct keymap_entry {
+    uint64_t hash;
+    uint32_t size;
+    struct xkb_keymap *keymap;
+};
+
+struct key_lookup {
+    xkb_keysym_t keysym;
+    char utf8[8];
+    int filled;
+};
+
+struct xkb_context *xkb_context;
+struct keymap_entry keymap_cache[KEYMAP_CACHE_SIZE];
+uint32_t keymap_cache_length = 0;
+uint32_t keymap_cache_next = 0;
+struct xkb_keymap *xkb_keymap = NULL;
+struct xkb_state *xkb_state = NULL;
+struct key_lookup key_table[KEY_TABLE_SIZE];
+// Last lookup of a keycode past the table.
+struct key_lookup key_uncached;
+
+static uint64_t hash_keymap(const char *data, uint32_t size)
+{
+    // FNV-1a.
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (uint32_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static void clear_key_table()
+{
+    for (uint32_t i = 0; i < KEY_TABLE_SIZE; ++i) {
+        key_table[i].filled = 0;
+    }
+}
+
+static struct xkb_keymap* compile_keymap(const char *data, uint32_t size)
+{
+    uint64_t hash = hash_keymap(data, size);
+
+    for (uint32_t i = 0; i < keymap_cache_length; ++i) {
+        if (keymap_cache[i].hash == hash && keymap_cache[i].size == size) {
+            return keymap_cache[i].keymap;
+        }
+    }
+
+    struct xkb_keymap *keymap = xkb_keymap_new_from_string(xkb_context, data,
+        XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
+    if (keymap == NULL) {
+        return NULL;
+    }
+
+    struct keymap_entry *entry;
+    if (keymap_cache_length < KEYMAP_CACHE_SIZE) {
+        entry = &keymap_cache[keymap_cache_length++];
+    } else {
+        // Never evict the keymap in use.
+        if (keymap_cache[keymap_cache_next].keymap == xkb_keymap) {
+            keymap_cache_next = (keymap_cache_next + 1) % KEYMAP_CACHE_SIZE;
+        }
+        entry = &keymap_cache[keymap_cache_next];
+        xkb_keymap_unref(entry->keymap);
+        keymap_cache_next = (keymap_cache_next + 1) % KEYMAP_CACHE_SIZE;
+    }
+    entry->hash = hash;
+    entry->size = size;
+    entry->keymap = keymap;
+
+    return keymap;
+}
+
+static struct key_lookup* lookup_key(uint32_t key)
+{
+    static struct key_lookup none = { XKB_KEY_NoSymbol, "", 1 };
+
+    if (xkb_state == NULL) {
+        return &none;
+    }
+
+    struct key_lookup *entry;
+    if (key < KEY_TABLE_SIZE) {
+        entry = &key_table[key];
+        if (entry->filled) {
+            return entry;
+        }
+        entry->filled = 1;
+    } else {
+        // Rare keys past the table are translated on every call.
+        entry = &key_uncached;
+    }
+
+    // Evdev keycodes are offset by 8 in XKB.
+    entry->keysym = xkb_state_key_get_one_sym(xkb_state, key + 8);
+    xkb_state_key_get_utf8(xkb_state, key + 8,
+        entry->utf8, sizeof(entry->utf8));
+
+    return entry;
+}
+
+//============
+// Key Repeat
+//============
+
+// Repeats are synthesized from a CLOCK_MONOTONIC timerfd polled next to
+// the display fd, so they arrive on time without a busy loop.
+struct key_repeat {
+    int fd;
+    int32_t rate;   // Repeats per second. 0 disables repeat.
+    int32_t delay;  // Milliseconds before the first repeat.
+    uint32_t key;
+    int repeating;
+};
+
+struct key_repeat key_repeat = {
+    .fd = -1,
+    .rate = 25,
+    .delay = 600,
+    .key = 0,
+    .repeating = 0,
+};
+
+static void set_time(struct timespec *spec, uint64_t nanoseconds)
+{
+    spec->tv_sec = nanoseconds / 1000000000;
+    spec->tv_nsec = nanoseconds % 1000000000;
+}
+
+static void key_repeat_start(uint32_t key)
+{
+    struct itimerspec spec;
+
+    if (key_repeat.rate <= 0 || key_repeat.fd < 0) {
+        return;
+    }
+    // Modifiers and the like don't repeat.
+    if (xkb_keymap != NULL && !xkb_keymap_key_repeats(xkb_keymap, key + 8)) {
+        return;
+    }
+    key_repeat.key = key;
+    key_repeat.repeating = 1;
+
+    set_time(&spec.it_value, (uint64_t)key_repeat.delay * 1000000);
+    set_time(&spec.it_interval, 1000000000 / key_repeat.rate);
+    // Zero it_value disarms the timer.
+    if (key_repeat.delay == 0) {
+        spec.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(key_repeat.fd, 0, &spec, NULL);
+}
+
+static void key_repeat_stop()
+{
+    struct itimerspec spec = { 0 };
+
+    key_repeat.repeating = 0;
+    if (key_repeat.fd >= 0) {
+        timerfd_settime(key_repeat.fd, 0, &spec, NULL);
+    }
+}
+
+static void key_repeat_dispatch()
+{
+    uint64_t expirations;
+
+    if (read(key_repeat.fd, &expirations, sizeof(expirations)) !=
+            sizeof(expirations)) {
+        return;
+    }
+    if (!key_repeat.repeating) {
+        return;
+    }
+    // One event per elapsed interval, even if the loop woke up late.
+    for (uint64_t i = 0; i < expirations; ++i) {
+        fprintf(stderr, "Key is %d \"%s\", state is repeat\n", key_repeat.key,
+            lookup_key(key_repeat.key)->utf8);
+    }
+}
+
 //============
 // Keyboard
 //============
 static void keyboard_keymap_handler(void *data, struct wl_keyboard *keyboard,
         uint32_t format, int fd, uint32_t size)
 {
+    if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1) {
+        close(fd);
+        return;
+    }
+
+    char *keymap_string = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (keymap_string == MAP_FAILED) {
+        fprintf(stderr, "Can't map keymap\n");
+        return;
+    }
+    struct xkb_keymap *keymap = compile_keymap(keymap_string, size);
+    munmap(keymap_string, size);
+    if (keymap == NULL) {
+        fprintf(stderr, "Can't compile keymap\n");
+        return;
+    }
+    if (keymap == xkb_keymap) {
+        return;
+    }
+
+    if (xkb_state != NULL) {
+        xkb_state_unref(xkb_state);
+    }
+    xkb_keymap = keymap;
+    xkb_state = xkb_state_new(keymap);
+    clear_key_table();
 }
 
 static void keyboard_enter_handler(void *data, struct wl_keyboard *keyboard,
@@ -70,12 +294,20 @@ static void keyboard_leave_handler(void *data, struct wl_keyboard *keyboard,
         uint32_t serial, struct wl_surface *surface)
 {
     fprintf(stderr, "Keyboard lost focus\n");
+    key_repeat_stop();
 }
 
 static void keyboard_key_handler(void *data, struct wl_keyboard *keyboard,
         uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
 {
-    fprintf(stderr, "Key is %d, state is %d\n", key, state);
+    fprintf(stderr, "Key is %d \"%s\", state is %d\n", key,
+        lookup_key(key)->utf8, state);
+
+    if (state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+        key_repeat_start(key);
+    } else if (key_repeat.repeating && key_repeat.key == key) {
+        key_repeat_stop();
+    }
 }
 
 static void keyboard_modifiers_handler(void *data, struct wl_keyboard *keyboard,
@@ -84,6 +316,23 @@ static void keyboard_modifiers_handler(void *data, struct wl_keyboard *keyboard,
 {
     fprintf(stderr, "Modifiers depressed %d, latched %d, locked %d, group %d\n",
         mods_depressed, mods_latched, mods_locked, group);
+
+    if (xkb_state != NULL &&
+            xkb_state_update_mask(xkb_state, mods_depressed, mods_latched,
+                mods_locked, 0, 0, group) != 0) {
+        clear_key_table();
+    }
+}
+
+static void keyboard_repeat_info_handler(void *data,
+        struct wl_keyboard *keyboard, int32_t rate, int32_t delay)
+{
+    fprintf(stderr, "Repeat rate %d, delay %d\n", rate, delay);
+    key_repeat.rate = rate;
+    key_repeat.delay = delay;
+    if (rate == 0) {
+        key_repeat_stop();
+    }
 }
 
 static const struct wl_keyboard_listener keyboard_listener = {
@@ -92,6 +341,7 @@ static const struct wl_keyboard_listener keyboard_listener = {
     .leave = keyboard_leave_handler,
     .key = keyboard_key_handler,
     .modifiers = keyboard_modifiers_handler,
+    .repeat_info = keyboard_repeat_info_handler,
 };
 
 //==============
@@ -188,8 +438,14 @@ static void seat_handle_capabilities(void *data, struct wl_seat *seat,
     }
 }
 
+static void seat_handle_name(void *data, struct wl_seat *seat,
+        const char *name)
+{
+}
+
 static const struct wl_seat_listener seat_listener = {
     seat_handle_capabilities,
+    seat_handle_name,
 };
 
 //============
@@ -379,7 +635,9 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
     (void)version;
 
     if (strcmp(interface, "wl_seat") == 0) {
-        seat = wl_registry_bind(registry, id, &wl_seat_interface, 1);
+        // Version 4 for wl_keyboard.repeat_info, if offered.
+        seat = wl_registry_bind(registry, id, &wl_seat_interface,
+            version < 4 ? version : 4);
         wl_seat_add_listener(seat, &seat_listener, NULL);
     } else if (strcmp(interface, "wl_compositor") == 0) {
         compositor = wl_registry_bind(registry, id, &wl_compositor_interface,
@@ -437,6 +695,8 @@ int main(int argc, char *argv[])
     }
     printf("Connected to display.\n");
 
+    xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+
     struct wl_registry *registry = wl_display_get_registry(display);
     wl_registry_add_listener(registry, &registry_listener, NULL);
 
@@ -528,9 +788,46 @@ int main(int argc, char *argv[])
 
     wl_surface_commit(surface);
 
-    while (wl_display_dispatch(display) != -1) {
-        ;
+    key_repeat.fd = timerfd_create(CLOCK_MONOTONIC,
+        TFD_NONBLOCK | TFD_CLOEXEC);
+
+    struct pollfd fds[2] = {
+        { wl_display_get_fd(display), POLLIN, 0 },
+        { key_repeat.fd, POLLIN, 0 },
+    };
+    while (1) {
+        while (wl_display_prepare_read(display) != 0) {
+            wl_display_dispatch_pending(display);
+        }
+        wl_display_flush(display);
+
+        if (poll(fds, 2, -1) < 0) {
+            wl_display_cancel_read(display);
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            if (wl_display_read_events(display) < 0) {
+                break;
+            }
+        } else {
+            wl_display_cancel_read(display);
+        }
+        if (fds[1].revents & POLLIN) {
+            key_repeat_dispatch();
+        }
+        if (wl_display_dispatch_pending(display) < 0) {
+            break;
+        }
+    }
+    close(key_repeat.fd);
+
+    if (xkb_state != NULL) {
+        xkb_state_unref(xkb_state);
+    }
+    for (uint32_t i = 0; i < keymap_cache_length; ++i) {
+        xkb_keymap_unref(keymap_cache[i].keymap);
     }
+    xkb_context_unref(xkb_context);
 
     wl_display_disconnect(display);
     printf("Disconnected from display.\n");
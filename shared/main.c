@@ -301,7 +301,8 @@ int main(int argc, char *argv[])
     wl_surface_attach(surface, buffer, 0, 0);
     wl_surface_commit(surface);
 
-    // Drawing pixels.
+    // Drawing pixels. Alpha is 0xde, so no opaque region is set and the
+    // compositor blends the surface with what is below.
     uint32_t *pixel = shm_data;
     for (int i = 0; i < 480 * 360; ++i) {
         *pixel = 0xde000000;
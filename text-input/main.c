@@ -37,21 +37,160 @@ void *shm_data2;
 int WIDTH = 480;
 int HEIGHT = 360;
 
+//===============
+// Text Field
+//===============
+
+// Text is kept in bytes and the cursor is a byte offset, as the protocol
+// counts both in UTF-8 bytes. Less than the 4000 byte limit of
+// set_surrounding_text, so the whole text is always sent.
+#define TEXT_FIELD_CAPACITY 1024
+
+struct text_field {
+    char text[TEXT_FIELD_CAPACITY];
+    uint32_t length;
+    uint32_t cursor;
+
+    // Shown at the cursor, not part of text.
+    char *preedit;
+    int32_t preedit_cursor_begin;
+    int32_t preedit_cursor_end;
+};
+
+struct text_field text_field = {
+    .text = "",
+    .length = 0,
+    .cursor = 0,
+    .preedit = NULL,
+    .preedit_cursor_begin = 0,
+    .preedit_cursor_end = 0,
+};
+
+static void text_field_delete(uint32_t before_length, uint32_t after_length)
+{
+    if (before_length > text_field.cursor) {
+        before_length = text_field.cursor;
+    }
+    if (after_length > text_field.length - text_field.cursor) {
+        after_length = text_field.length - text_field.cursor;
+    }
+
+    uint32_t begin = text_field.cursor - before_length;
+    uint32_t end = text_field.cursor + after_length;
+    memmove(text_field.text + begin, text_field.text + end,
+        text_field.length - end + 1);
+    text_field.length -= before_length + after_length;
+    text_field.cursor = begin;
+}
+
+static void text_field_insert(const char *text)
+{
+    uint32_t length = strlen(text);
+
+    if (text_field.length + length >= TEXT_FIELD_CAPACITY) {
+        fprintf(stderr, "Text field is full.\n");
+        return;
+    }
+
+    char *at = text_field.text + text_field.cursor;
+    memmove(at + length, at, text_field.length - text_field.cursor + 1);
+    memcpy(at, text, length);
+    text_field.length += length;
+    text_field.cursor += length;
+}
+
 //===============
 // Text Input
 //===============
+
+// Events between two done events are only recorded here, then applied
+// together on done, so an IME update is a single change to the text field.
+struct text_input_pending {
+    char *preedit;
+    int32_t preedit_cursor_begin;
+    int32_t preedit_cursor_end;
+    char *commit;
+    uint32_t delete_before;
+    uint32_t delete_after;
+};
+
+struct text_input_state {
+    struct text_input_pending pending;
+    // Number of commit requests sent, compared with the done serial.
+    uint32_t serial;
+    uint32_t done_serial;
+    int enabled;
+    // Surrounding text changed since the last set_surrounding_text.
+    int surrounding_dirty;
+};
+
+struct text_input_state text_input_state = {
+    .pending = { NULL, 0, 0, NULL, 0, 0 },
+    .serial = 0,
+    .done_serial = 0,
+    .enabled = 0,
+    .surrounding_dirty = 0,
+};
+
+static void request_redraw();
+
+static void text_input_pending_clear()
+{
+    struct text_input_pending *pending = &text_input_state.pending;
+
+    free(pending->preedit);
+    free(pending->commit);
+    pending->preedit = NULL;
+    pending->preedit_cursor_begin = 0;
+    pending->preedit_cursor_end = 0;
+    pending->commit = NULL;
+    pending->delete_before = 0;
+    pending->delete_after = 0;
+}
+
+static void text_input_commit()
+{
+    zwp_text_input_v3_commit(text_input);
+    text_input_state.serial += 1;
+}
+
+// Called at most once per frame, from draw.
+static void text_input_flush_surrounding()
+{
+    if (!text_input_state.enabled || !text_input_state.surrounding_dirty) {
+        return;
+    }
+    // Wait until the compositor has seen all our commits.
+    if (text_input_state.done_serial != text_input_state.serial) {
+        return;
+    }
+    text_input_state.surrounding_dirty = 0;
+
+    zwp_text_input_v3_set_surrounding_text(text_input, text_field.text,
+        text_field.cursor, text_field.cursor);
+    zwp_text_input_v3_set_cursor_rectangle(text_input,
+        0, 0, 100, 100);
+    text_input_commit();
+}
+
 static void zwp_text_input_enter_handler(void *data,
         struct zwp_text_input_v3 *text_input,
         struct wl_surface *surface)
 {
     fprintf(stderr, "text_input # enter\n");
 
+    text_input_state.enabled = 1;
+    text_input_state.surrounding_dirty = 0;
+    text_input_pending_clear();
+
     zwp_text_input_v3_enable(text_input);
 
+    zwp_text_input_v3_set_surrounding_text(text_input, text_field.text,
+        text_field.cursor, text_field.cursor);
     zwp_text_input_v3_set_cursor_rectangle(text_input,
         0, 0, 100, 100);
 
-    zwp_text_input_v3_commit(text_input);
+    text_input_commit();
 }
 
 static void zwp_text_input_leave_handler(void *data,
@@ -60,38 +199,96 @@ static void zwp_text_input_leave_handler(void *data,
 {
     fprintf(stderr, "text_input # leave\n");
 
+    text_input_state.enabled = 0;
+    text_input_pending_clear();
+    if (text_field.preedit != NULL) {
+        free(text_field.preedit);
+        text_field.preedit = NULL;
+        request_redraw();
+    }
+
     zwp_text_input_v3_disable(text_input);
-    zwp_text_input_v3_commit(text_input);
+    text_input_commit();
 }
 
 static void zwp_text_input_preedit_string_handler(void *data,
         struct zwp_text_input_v3 *text_input,
         const char *text, int cursor_begin, int cursor_end)
 {
-    fprintf(stderr, "text_input # preedit_string | text:\"%s\", cursor_begin: %d, cursor_end: %d\n",
-        text, cursor_begin, cursor_end);
+    struct text_input_pending *pending = &text_input_state.pending;
+
+    free(pending->preedit);
+    pending->preedit = (text != NULL) ? strdup(text) : NULL;
+    pending->preedit_cursor_begin = cursor_begin;
+    pending->preedit_cursor_end = cursor_end;
 }
 
 static void zwp_text_input_commit_string_handler(void *data,
         struct zwp_text_input_v3 *text_input,
         const char *text)
 {
-    fprintf(stderr, "text_input # commit_string | text: \"%s\"\n", text);
+    struct text_input_pending *pending = &text_input_state.pending;
+
+    free(pending->commit);
+    pending->commit = (text != NULL) ? strdup(text) : NULL;
 }
 
 static void zwp_text_input_delete_surrounding_text_handler(void *data,
         struct zwp_text_input_v3 *text_input,
         unsigned int before_length, unsigned int after_length)
 {
-    fprintf(stderr, "text_input # delete_surrounding_text | before_length: %u, after_length: %u\n",
-        before_length, after_length);
+    struct text_input_pending *pending = &text_input_state.pending;
+
+    pending->delete_before = before_length;
+    pending->delete_after = after_length;
 }
 
 static void zwp_text_input_done_handler(void *data,
         struct zwp_text_input_v3 *text_input,
         unsigned int serial)
 {
-    fprintf(stderr, "text_input # done | serial: %u\n", serial);
+    struct text_input_pending *pending = &text_input_state.pending;
+    int changed = 0;
+
+    // Applied in the order the protocol defines. The old preedit is
+    // replaced in any case, it is not part of the text.
+    if (text_field.preedit != NULL || pending->preedit != NULL) {
+        changed = 1;
+    }
+    if (pending->delete_before != 0 || pending->delete_after != 0) {
+        text_field_delete(pending->delete_before, pending->delete_after);
+        text_input_state.surrounding_dirty = 1;
+        changed = 1;
+    }
+    if (pending->commit != NULL) {
+        text_field_insert(pending->commit);
+        text_input_state.surrounding_dirty = 1;
+        changed = 1;
+    }
+    free(text_field.preedit);
+    text_field.preedit = pending->preedit;
+    text_field.preedit_cursor_begin = pending->preedit_cursor_begin;
+    text_field.preedit_cursor_end = pending->preedit_cursor_end;
+    pending->preedit = NULL;
+
+    text_input_pending_clear();
+
+    // The compositor answered an older commit. The changes are still
+    // applied, but our state is sent again only once it catches up.
+    text_input_state.done_serial = serial;
+    if (serial != text_input_state.serial) {
+        fprintf(stderr, "text_input # done | serial: %u, expected: %u\n",
+            serial, text_input_state.serial);
+    }
+
+    if (changed) {
+        fprintf(stderr, "text_input # done | text: \"%s\", preedit: \"%s\"\n",
+            text_field.text,
+            (text_field.preedit != NULL) ? text_field.preedit : "");
+    }
+    if (changed || text_input_state.surrounding_dirty) {
+        request_redraw();
+    }
 }
 
 static const struct zwp_text_input_v3_listener zwp_text_input_listener = {
@@ -456,6 +653,57 @@ static void create_window2()
     wl_surface_commit(surface2);
 }
 
+//==============
+// Redraw
+//==============
+
+// Redraws are driven by frame callbacks. Any number of text input
+// updates within a frame result in one commit of the surface and one
+// set_surrounding_text.
+struct wl_callback *frame_callback = NULL;
+int needs_redraw = 0;
+
+static void draw();
+
+static void frame_done_handler(void *data, struct wl_callback *callback,
+        uint32_t time)
+{
+    wl_callback_destroy(callback);
+    frame_callback = NULL;
+
+    if (needs_redraw) {
+        draw();
+    }
+}
+
+static const struct wl_callback_listener frame_listener = {
+    .done = frame_done_handler,
+};
+
+static void draw()
+{
+    needs_redraw = 0;
+
+    text_input_flush_surrounding();
+
+    frame_callback = wl_surface_frame(surface);
+    wl_callback_add_listener(frame_callback, &frame_listener, NULL);
+
+    wl_surface_attach(surface, buffer, 0, 0);
+    wl_surface_damage(surface, 0, 0, WIDTH, HEIGHT);
+    wl_surface_commit(surface);
+}
+
+static void request_redraw()
+{
+    needs_redraw = 1;
+    // Before the first buffer, or a frame is already on its way.
+    if (buffer == NULL || frame_callback != NULL) {
+        return;
+    }
+    draw();
+}
+
 static void shm_format(void *data, struct wl_shm *wl_shm, uint32_t format)
 {
     // struct display *d = data;
@@ -249,10 +249,20 @@ static struct wl_buffer* create_buffer2()
     return buff;
 }
 
+// Buffers have no transparent pixels.
+static void set_opaque_region(struct wl_surface *wl_surface)
+{
+    struct wl_region *region = wl_compositor_create_region(compositor);
+    wl_region_add(region, 0, 0, WIDTH, HEIGHT);
+    wl_surface_set_opaque_region(wl_surface, region);
+    wl_region_destroy(region);
+}
+
 static void create_window()
 {
     buffer = create_buffer();
 
+    set_opaque_region(surface);
     wl_surface_attach(surface, buffer, 0, 0);
     // wl_surface_damage(surface, 0, 0, WIDTH, HEIGHT);
     wl_surface_commit(surface);
@@ -262,6 +272,7 @@ static void create_window2()
 {
     buffer2 = create_buffer2();
 
+    set_opaque_region(surface2);
     wl_surface_attach(surface2, buffer2, 0, 0);
     wl_surface_commit(surface2);
 }
@@ -14,6 +14,8 @@
 #include <cairo.h>
 
 #include "xdg-shell.h"
+#include "presentation-time.h"
+#include "presentation-stats.h"
 
 #include "vulkan/instance.h"
 #include "vulkan/surface.h"
@@ -30,6 +32,9 @@ struct wl_subcompositor *subcompositor = NULL;
 struct wl_surface *wl_surface;
 struct wl_region *region;
 struct wl_output *output;
+struct wp_presentation *presentation = NULL;
+clockid_t presentation_clock_id = CLOCK_MONOTONIC;
+PresentationStats presentation_stats;
 
 struct xdg_wm_base *xdg_wm_base = NULL;
 struct xdg_surface *xdg_surface = NULL;
@@ -842,6 +847,9 @@ void draw_frame(std::shared_ptr<vk::Device> device,
     present_info.pNext = NULL;
     present_info.pResults = NULL;
 
+    // The present commits the surface.
+    presentation_stats.frame_submitted(presentation, presentation_clock_id,
+        wl_surface);
     fprintf(stderr, "vkQueuePresentKHR() - queue: %p\n", device->present_queue());
     result = vkQueuePresentKHR(device->present_queue(), &present_info);
     if (result != VK_SUCCESS) {
@@ -896,6 +904,19 @@ const struct xdg_toplevel_listener xdg_toplevel_listener = {
 // Output
 //==============
 
+//================
+// Presentation
+//================
+static void presentation_clock_id_handler(void *data,
+        struct wp_presentation *presentation, uint32_t clk_id)
+{
+    presentation_clock_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+    .clock_id = presentation_clock_id_handler,
+};
+
 //==============
 // Global
 //==============
@@ -913,6 +934,11 @@ static void global_registry_handler(void *data, struct wl_registry *registry,
         xdg_wm_base = (struct xdg_wm_base*)wl_registry_bind(registry,
             id, &xdg_wm_base_interface, 1);
         xdg_wm_base_add_listener(xdg_wm_base, &xdg_wm_base_listener, NULL);
+    } else if (strcmp(interface, "wp_presentation") == 0) {
+        presentation = (struct wp_presentation*)wl_registry_bind(registry,
+            id, &wp_presentation_interface, 1);
+        wp_presentation_add_listener(presentation, &presentation_listener,
+            NULL);
     } else {
         printf("(%d) Got a registry event for <%s> id <%d>\n",
             version, interface, id);
@@ -1005,6 +1031,9 @@ int main(int argc, char *argv[])
     create_vulkan_command_buffers(device, command_pool);
     create_vulkan_sync_objects(device);
 
+    // kill -USR1 to print presentation stats.
+    PresentationStats::install_signal_handler();
+
     draw_frame(device, swapchain, render_pass);
 
     wl_surface_commit(wl_surface);
@@ -1015,8 +1044,14 @@ int main(int argc, char *argv[])
         res = wl_display_dispatch(display);
         fprintf(stderr, "wl_display_dispatch() called.\n");
         draw_frame(device, swapchain, render_pass);
+
+        if (PresentationStats::report_requested()) {
+            presentation_stats.report(stderr);
+        }
     }
     fprintf(stderr, "wl_display_dispatch() - res: %d\n", res);
+    presentation_stats.report(stderr);
+    presentation_stats.clear();
 
     wl_display_disconnect(display);
     printf("Disconnected from display.\n");
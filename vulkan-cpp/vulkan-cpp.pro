@@ -5,7 +5,8 @@ SOURCES += main.cpp \
     vulkan/swapchain.cpp \
     vulkan/render-pass.cpp \
     vulkan/command-pool.cpp \
-    vulkan/utils.cpp
+    vulkan/utils.cpp \
+    presentation-stats.cpp
 
 HEADERS += vulkan/instance.h \
     vulkan/surface.h \
@@ -14,7 +15,8 @@ HEADERS += vulkan/instance.h \
     vulkan/render-pass.h \
     vulkan/vertex.h \
     vulkan/command-pool.h \
-    vulkan/utils.h
+    vulkan/utils.h \
+    presentation-stats.h
 
 CONFIG += link_pkgconfig
 
@@ -1,11 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <wayland-client.h>
 #include <wayland-egl.h>
 #include <EGL/egl.h>
 
 #include <sys/time.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 
 #define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
@@ -26,23 +30,43 @@ struct {
     struct wl_seat *wl_seat;
     struct wl_pointer *wl_pointer;
     int32_t button_serial;
+    // Surface the pointer is on. NULL after leave.
+    struct wl_surface *pointer_surface;
+    // Last pointer position on the toplevel. Popups open there.
+    int32_t pointer_x;
+    int32_t pointer_y;
 } seat;
 
 struct xdg_wm_base *xdg_wm_base = NULL;
 struct xdg_surface *xdg_surface = NULL;
 struct xdg_toplevel *xdg_toplevel = NULL;
-struct xdg_positioner *xdg_positioner = NULL;
+
+#define POPUP_WIDTH 100
+#define POPUP_HEIGHT 50
+// Idle popups kept with their EGL surface. More are destroyed on close.
+#define POPUP_POOL_SIZE 2
 
 struct popup {
     struct wl_surface *wl_surface;
     struct wl_egl_window *egl_window;
     EGLSurface egl_surface;
+    // Role objects. NULL while the popup is in the pool.
     struct xdg_surface *xdg_surface;
     struct xdg_popup *xdg_popup;
+    int32_t width;
+    int32_t height;
+    uint32_t reposition_token;
 };
 
 struct popup popup = { NULL, };
 
+// Closed popups. Opening one takes the wl_surface and EGL surface from
+// here, so it only needs new role objects and a single commit.
+struct {
+    struct popup popups[POPUP_POOL_SIZE];
+    int length;
+} popup_pool = { { { NULL, }, }, 0 };
+
 EGLDisplay egl_display;
 EGLConfig egl_conf;
 EGLSurface egl_surface;
@@ -56,11 +80,68 @@ float pos_x = 1.0f;
 float pos_y = 1.0f;
 
 
-static void init_popup(struct popup*, uint32_t);
+static void init_popup(struct popup*, struct xdg_positioner*, uint32_t);
 
 static void destroy_popup(struct popup*);
 
-GLuint load_shader(const char *shader_path, GLenum type)
+static struct xdg_positioner* create_positioner();
+
+//==============
+// Program Cache
+//==============
+
+#define VERT_SHADER_PATH "basic_vert_shader.vert"
+#define FRAG_SHADER_PATH "color_frag_shader.frag"
+// Linked program saved by the driver, loaded instead of compiling.
+#define PROGRAM_BINARY_PATH "program.bin"
+
+// The linked program is built once and only rebuilt when a shader file
+// in the working directory changes.
+struct program_cache {
+    // Hash of the shader sources and the GL driver. A saved binary is
+    // only used if it was saved with the same key.
+    uint64_t key;
+    // inotify on the working directory. -1 if not available.
+    int inotify_fd;
+    int stale;
+};
+
+struct program_cache program_cache = { 0, -1, 1 };
+
+static char* read_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Can't open %s.\n", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    rewind(f);
+
+    char *source = malloc(file_size + 1);
+    size_t read = fread(source, 1, file_size, f);
+    source[read] = '\0';
+
+    fclose(f);
+
+    return source;
+}
+
+// FNV-1a.
+static uint64_t hash_string(uint64_t hash, const char *str)
+{
+    if (str == NULL) {
+        return hash;
+    }
+    for (; *str != '\0'; ++str) {
+        hash ^= (unsigned char)*str;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+GLuint load_shader(const char *source, GLenum type)
 {
     GLuint shader;
     GLint compiled;
@@ -71,23 +152,8 @@ GLuint load_shader(const char *shader_path, GLenum type)
         return 0;
     }
 
-    char *shader_s;
-    // Read shader from source.
-    {
-        FILE *f = fopen(shader_path, "r");
-        fseek(f, 0, SEEK_END);
-        long file_size = ftell(f);
-        rewind(f);
-
-        shader_s = malloc(file_size + 1);
-        fread(shader_s, 1, file_size, f);
-        shader_s[file_size] = '\0';
-
-        fclose(f);
-    }
-
     // Load the shader source.
-    glShaderSource(shader, 1, (const char**)&shader_s, NULL);
+    glShaderSource(shader, 1, &source, NULL);
 
     // Compile the shader.
     glCompileShader(shader);
@@ -99,7 +165,9 @@ GLuint load_shader(const char *shader_path, GLenum type)
 
         glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_len);
         if (info_len > 1) {
-            char *info_log = malloc(sizeof(char));
+            char *info_log = malloc(sizeof(char) * info_len);
+
+            glGetShaderInfoLog(shader, info_len, NULL, info_log);
             fprintf(stderr, "Error compiling shader: %s\n", info_log);
             free(info_log);
         }
@@ -111,13 +179,21 @@ GLuint load_shader(const char *shader_path, GLenum type)
     return shader;
 }
 
-void program_shaders(GLuint program, GLuint vert_shader, GLuint frag_shader)
+GLuint program_shaders(GLuint vert_shader, GLuint frag_shader)
 {
+    GLuint program = glCreateProgram();
+
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+        GL_TRUE);
     glAttachShader(program, vert_shader);
     glAttachShader(program, frag_shader);
 
     glLinkProgram(program);
 
+    // The program keeps what it needs.
+    glDetachShader(program, vert_shader);
+    glDetachShader(program, frag_shader);
+
     // Check the link status.
     GLint linked;
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
@@ -133,170 +209,391 @@ void program_shaders(GLuint program, GLuint vert_shader, GLuint frag_shader)
         }
 
         glDeleteProgram(program);
+        return 0;
     }
+
+    return program;
 }
 
-void set_vert_uniforms(GLuint program)
+static GLuint load_program_binary(uint64_t key)
 {
-    GLuint pos = glGetUniformLocation(program, "resolution");
-    float resolution[2] = { (float)window_width, (float)window_height };
-    glUniform2fv(pos, 1, resolution);
+    FILE *f = fopen(PROGRAM_BINARY_PATH, "r");
+    if (f == NULL) {
+        return 0;
+    }
+
+    uint64_t saved_key;
+    GLenum format;
+    GLint length;
+    if (fread(&saved_key, sizeof(saved_key), 1, f) != 1 ||
+            fread(&format, sizeof(format), 1, f) != 1 ||
+            fread(&length, sizeof(length), 1, f) != 1 ||
+            saved_key != key || length <= 0) {
+        fclose(f);
+        return 0;
+    }
+
+    void *binary = malloc(length);
+    GLuint program = 0;
+    if (fread(binary, length, 1, f) == 1) {
+        program = glCreateProgram();
+        glProgramBinary(program, format, binary, length);
+
+        // Drivers reject binaries of other versions.
+        GLint linked;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    free(binary);
+    fclose(f);
+
+    return program;
 }
 
-void set_uniform_color(GLuint program, float *color)
+static void save_program_binary(GLuint program, uint64_t key)
 {
-    GLuint pos = glGetUniformLocation(program, "color");
-    float col[4] = { color[0], color[1], color[2], color[3] };
-    glUniform4fv(pos, 1, col);
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    void *binary = malloc(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary);
+
+    FILE *f = fopen(PROGRAM_BINARY_PATH, "w");
+    if (f != NULL) {
+        fwrite(&key, sizeof(key), 1, f);
+        fwrite(&format, sizeof(format), 1, f);
+        fwrite(&length, sizeof(length), 1, f);
+        fwrite(binary, length, 1, f);
+        fclose(f);
+    }
+    free(binary);
 }
 
-void set_uniform_validGeometry(GLuint program,
-                               float x,
-                               float y,
-                               float width,
-                               float height)
+// Build program_object from the shader files. The old program is kept if
+// the new sources fail, so a broken edit does not blank the window.
+static void build_program()
 {
-    GLuint pos = glGetUniformLocation(program, "validGeometry");
-    float geo[4] = { x, y, width, height };
-    glUniform4fv(pos, 1, geo);
+    program_cache.stale = 0;
+
+    char *vert_source = read_file(VERT_SHADER_PATH);
+    char *frag_source = read_file(FRAG_SHADER_PATH);
+    if (vert_source == NULL || frag_source == NULL) {
+        free(vert_source);
+        free(frag_source);
+        return;
+    }
+
+    uint64_t key = 0xcbf29ce484222325;
+    key = hash_string(key, vert_source);
+    key = hash_string(key, frag_source);
+    key = hash_string(key, (const char*)glGetString(GL_VENDOR));
+    key = hash_string(key, (const char*)glGetString(GL_RENDERER));
+    key = hash_string(key, (const char*)glGetString(GL_VERSION));
+
+    GLuint program = 0;
+    if (key == program_cache.key && program_object != 0) {
+        // Touched but not changed.
+        program = program_object;
+    } else {
+        program = load_program_binary(key);
+    }
+
+    if (program == 0) {
+        fprintf(stderr, "Compiling shaders.\n");
+        GLuint vert_shader = load_shader(vert_source, GL_VERTEX_SHADER);
+        GLuint frag_shader = load_shader(frag_source, GL_FRAGMENT_SHADER);
+        if (vert_shader != 0 && frag_shader != 0) {
+            program = program_shaders(vert_shader, frag_shader);
+        }
+        glDeleteShader(vert_shader);
+        glDeleteShader(frag_shader);
+
+        if (program != 0) {
+            save_program_binary(program, key);
+        }
+    }
+    free(vert_source);
+    free(frag_source);
+
+    if (program != 0 && program != program_object) {
+        if (program_object != 0) {
+            glDeleteProgram(program_object);
+        }
+        program_object = program;
+        program_cache.key = key;
+    }
 }
 
-void set_uniform_geometry(GLuint program,
-                          float x,
-                          float y,
-                          float width,
-                          float height)
+// Hot reload. Marks the program stale when an editor writes a shader file.
+static void check_shader_files()
 {
-    GLuint pos = glGetUniformLocation(program, "geometry");
-    float geo[4] = { x, y, width, height };
-    glUniform4fv(pos, 1, geo);
+    if (program_cache.inotify_fd < 0) {
+        return;
+    }
+
+    char events[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(program_cache.inotify_fd, events, sizeof(events))) > 0) {
+        for (char *it = events; it < events + len;
+                it += sizeof(struct inotify_event) +
+                    ((struct inotify_event*)it)->len) {
+            const struct inotify_event *event = (struct inotify_event*)it;
+            if (event->len > 0 &&
+                    (strcmp(event->name, VERT_SHADER_PATH) == 0 ||
+                    strcmp(event->name, FRAG_SHADER_PATH) == 0)) {
+                program_cache.stale = 1;
+            }
+        }
+    }
 }
 
-void calc_points(float x, float y, float width, float height, float *points)
+void init_program_cache()
 {
-    float half_width = window_width / 2;
-    float half_height = window_height / 2;
+    // Editors often replace the file, so watch the directory.
+    program_cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (program_cache.inotify_fd >= 0 &&
+            inotify_add_watch(program_cache.inotify_fd, ".",
+                IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(program_cache.inotify_fd);
+        program_cache.inotify_fd = -1;
+    }
 
-    // Top-left
-    points[0] = x;
-    points[1] = y;
-    // Bottom-left
-    points[3] = x;
-    points[4] = y + height;
-    // Bottom-right
-    points[6] = x + width;
-    points[7] = y + height;
-    // Top-right
-    points[9] = x + width;
-    points[10] = y;
+    build_program();
 }
 
-void draw_frame()
+// Current program. Needs the context to be current.
+GLuint use_program_cache()
 {
-    GLfloat vVertices[] = {
-        0.0f, 0.5f, 0.0f,   // top left
-        -0.5f, -0.5f, 0.0f, // bottom left
-        0.5f, -0.5f, 0.0f,  // bottom right
-        0.5f, 0.5f, 0.0f,   // top right
-    };
-    GLuint indices[] = {
-        0, 1, 3,        // Top left, bottom left, bottom right
-        // 3, 2, 1,
-        1, 2, 3,        // Bottom left, top right, bottom right
-    };
+    check_shader_files();
+    if (program_cache.stale) {
+        build_program();
+    }
 
-    fprintf(stderr, "Draw frame.\n");
+    return program_object;
+}
 
-    GLuint vert_shader;
-    GLuint frag_shader;
-    vert_shader = load_shader("basic_vert_shader.vert", GL_VERTEX_SHADER);
-    frag_shader = load_shader("color_frag_shader.frag", GL_FRAGMENT_SHADER);
-    program_shaders(program_object, vert_shader, frag_shader);
+//==============
+// GL State
+//==============
 
-    eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context);
+// Last state set on the context. Setters skip calls that change nothing.
+struct gl_state {
+    GLuint program;
+    GLuint vao;
+    int blend;
+    // Uniform locations, resolved once per linked program.
+    GLuint uniforms_program;
+    GLint resolution_location;
+    float resolution[2];
+};
 
-    // Set the viewport.
-    glViewport(0, 0, window_width, window_height);
+struct gl_state gl_state = { 0, };
 
-    // Clear the color buffer.
-    glClearColor(1.0, 1.0, 1.0, 1.0);
-    // Blend.
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void gl_use_program(GLuint program)
+{
+    if (gl_state.program != program) {
+        glUseProgram(program);
+        gl_state.program = program;
+    }
+}
 
-    glClear(GL_COLOR_BUFFER_BIT);
-    // Use the program object.
-    glUseProgram(program_object);
-    set_vert_uniforms(program_object);
+void gl_bind_vertex_array(GLuint vao)
+{
+    if (gl_state.vao != vao) {
+        glBindVertexArray(vao);
+        gl_state.vao = vao;
+    }
+}
 
+void gl_set_blend(int enabled)
+{
+    if (gl_state.blend == enabled) {
+        return;
+    }
+    if (enabled) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    } else {
+        glDisable(GL_BLEND);
+    }
+    gl_state.blend = enabled;
+}
 
-   float color[] = { 1.0f, 0.0f, 0.0f, 1.0f };
+void set_vert_uniforms(GLuint program)
+{
+    if (gl_state.uniforms_program != program) {
+        gl_state.uniforms_program = program;
+        gl_state.resolution_location =
+            glGetUniformLocation(program, "resolution");
+        // Not uploaded to this program yet.
+        gl_state.resolution[0] = -1.0f;
+    }
 
-    // VAO.
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
+    if (gl_state.resolution[0] == (float)window_width &&
+            gl_state.resolution[1] == (float)window_height) {
+        return;
+    }
+    gl_state.resolution[0] = (float)window_width;
+    gl_state.resolution[1] = (float)window_height;
+    glUniform2fv(gl_state.resolution_location, 1, gl_state.resolution);
+}
+
+//==============
+// Rectangles
+//==============
 
-    // EBO.
+#define MAX_RECTS 256
+
+// Instance attributes of a rectangle. Locations 1 to 3 of the vertex
+// shader.
+struct rect_instance {
+    float geometry[4];
+    float color[4];
+    // Clip rectangle. All zero for no clipping.
+    float valid_geometry[4];
+};
+
+// Rectangles queued for one instanced draw.
+struct rect_batch {
+    GLuint vao;
+    GLuint quad_vbo;
     GLuint ebo;
-    glGenBuffers(1, &ebo);
+    GLuint instance_vbo;
+    struct rect_instance rects[MAX_RECTS];
+    int length;
+};
 
-    // VBO.
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
+struct rect_batch rect_batch = { 0, };
 
+static void init_rect_batch()
+{
+    // Unit quad, scaled and moved by the instance geometry.
+    static const GLfloat corners[] = {
+        0.0f, 0.0f,     // top left
+        0.0f, 1.0f,     // bottom left
+        1.0f, 1.0f,     // bottom right
+        1.0f, 0.0f,     // top right
+    };
+    static const GLuint indices[] = {
+        0, 1, 3,
+        1, 2, 3,
+    };
 
-    // 1st Rectangle.
-    glBindVertexArray(vao);
+    glGenVertexArrays(1, &rect_batch.vao);
+    gl_bind_vertex_array(rect_batch.vao);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glGenBuffers(1, &rect_batch.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rect_batch.ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
         GL_STATIC_DRAW);
 
-    calc_points(10.0f, 10.0f, 100.0f, 100.0f, vVertices);
+    glGenBuffers(1, &rect_batch.quad_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, rect_batch.quad_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glGenBuffers(1, &rect_batch.instance_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, rect_batch.instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(rect_batch.rects), NULL,
+        GL_STREAM_DRAW);
+
+    const GLsizei stride = sizeof(struct rect_instance);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride,
+        (void*)offsetof(struct rect_instance, geometry));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
+        (void*)offsetof(struct rect_instance, color));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride,
+        (void*)offsetof(struct rect_instance, valid_geometry));
+    for (GLuint i = 1; i <= 3; ++i) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-        sizeof(vVertices),
-        vVertices,
-        GL_STATIC_DRAW
-    );
+// Draw all queued rectangles with a single call.
+void flush_rects()
+{
+    if (rect_batch.length == 0) {
+        return;
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glEnableVertexAttribArray(0);
+    gl_bind_vertex_array(rect_batch.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, rect_batch.instance_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+        sizeof(struct rect_instance) * rect_batch.length, rect_batch.rects);
 
-    set_uniform_color(program_object, color);
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0,
+        rect_batch.length);
+    rect_batch.length = 0;
+}
 
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
+// Queue a rectangle. valid_geometry may be NULL for no clipping.
+void add_rect(float x, float y, float width, float height,
+        const float *color, const float *valid_geometry)
+{
+    if (rect_batch.length == MAX_RECTS) {
+        flush_rects();
+    }
 
+    struct rect_instance *rect = &rect_batch.rects[rect_batch.length];
+    rect->geometry[0] = x;
+    rect->geometry[1] = y;
+    rect->geometry[2] = width;
+    rect->geometry[3] = height;
+    for (int i = 0; i < 4; ++i) {
+        rect->color[i] = color[i];
+        rect->valid_geometry[i] =
+            (valid_geometry != NULL) ? valid_geometry[i] : 0.0f;
+    }
+    rect_batch.length += 1;
+}
 
-    // 2nd Rectangle.
-    glBindVertexArray(vao);
+void draw_frame()
+{
+    fprintf(stderr, "Draw frame.\n");
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-        GL_STATIC_DRAW);
+    eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context);
 
-    calc_points(30.0f, 30.0f, 300.0f, 300.0f, vVertices);
+    // Compiled once, rebuilt only when a shader file changed.
+    if (use_program_cache() == 0) {
+        return;
+    }
+    if (rect_batch.vao == 0) {
+        init_rect_batch();
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-        sizeof(vVertices),
-        vVertices,
-        GL_STATIC_DRAW
-    );
+    // Set the viewport.
+    glViewport(0, 0, window_width, window_height);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glEnableVertexAttribArray(0);
+    // Clear the color buffer.
+    glClearColor(1.0, 1.0, 1.0, 1.0);
+    // Blend.
+    gl_set_blend(1);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    // Use the program object.
+    gl_use_program(program_object);
+    set_vert_uniforms(program_object);
+
+    // 1st Rectangle.
+    const float color[] = { 1.0f, 0.0f, 0.0f, 1.0f };
+    add_rect(10.0f, 10.0f, 100.0f, 100.0f, color, NULL);
 
-    color[0] = 0.0f;
-    color[1] = 1.0f;
-    color[2] = 0.0f;
-    color[3] = 0.5f;
-    set_uniform_color(program_object, color);
-    set_uniform_validGeometry(program_object, 10.0f, 10.0f, 100.0f, 100.0f);
-    set_uniform_geometry(program_object, 30.0f, 30.0f, 300.0f, 300.0f);
+    // 2nd Rectangle, clipped to the 1st.
+    const float color2[] = { 0.0f, 1.0f, 0.0f, 0.5f };
+    const float valid_geometry[] = { 10.0f, 10.0f, 100.0f, 100.0f };
+    add_rect(30.0f, 30.0f, 300.0f, 300.0f, color2, valid_geometry);
 
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
+    flush_rects();
 
     struct timeval start;
     gettimeofday(&start, NULL);
@@ -307,10 +604,6 @@ void draw_frame()
     gettimeofday(&end, NULL);
     fprintf(stderr, "[%f] eglSwapBuffers\n",
         (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0);
-
-    // Clean up.
-    glDetachShader(program_object, vert_shader);
-    glDetachShader(program_object, frag_shader);
 }
 
 //===========
@@ -403,6 +696,12 @@ static void xdg_popup_configure_handler(void *data,
     fprintf(stderr, "XDG popup configure.\n");
     fprintf(stderr, " - x, y: (%d, %d)\n", x, y);
     fprintf(stderr, " - size: %dx%d\n", width, height);
+
+    struct popup *popup = (struct popup*)data;
+
+    // Applied with the xdg_surface.configure that follows.
+    popup->width = width;
+    popup->height = height;
 }
 
 static void xdg_popup_popup_done_handler(void *data,
@@ -426,6 +725,35 @@ static const struct xdg_popup_listener xdg_popup_listener = {
     .repositioned = xdg_popup_repositioned_handler,
 };
 
+static void popup_xdg_surface_configure_handler(void *data,
+        struct xdg_surface *xdg_surface, uint32_t serial)
+{
+    struct popup *popup = (struct popup*)data;
+
+    xdg_surface_ack_configure(xdg_surface, serial);
+
+    // Draw with the configured size. The swap commits the surface.
+    wl_egl_window_resize(popup->egl_window, popup->width, popup->height,
+        0, 0);
+    eglMakeCurrent(egl_display, popup->egl_surface, popup->egl_surface,
+        egl_context);
+    // Popups are drawn on configure only and the EGL surface is reused
+    // after unmapping. With the default interval the swap would wait for
+    // a frame callback of the previous mapping, which an unmapped surface
+    // never gets.
+    eglSwapInterval(egl_display, 0);
+
+    glViewport(0, 0, popup->width, popup->height);
+    glClearColor(0.0, 0.0, 1.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    eglSwapBuffers(egl_display, popup->egl_surface);
+}
+
+static const struct xdg_surface_listener popup_xdg_surface_listener = {
+    .configure = popup_xdg_surface_configure_handler,
+};
+
 //==============
 // Pointer
 //==============
@@ -433,11 +761,17 @@ static const struct xdg_popup_listener xdg_popup_listener = {
 static void pointer_enter_handler(void *data,
                                   struct wl_pointer *wl_pointer,
                                   uint32_t serial,
-                                  struct wl_surface *surface,
+                                  struct wl_surface *wl_surface,
                                   wl_fixed_t sx,
                                   wl_fixed_t sy)
 {
     fprintf(stderr, "Pointer enter handler.\n");
+
+    seat.pointer_surface = wl_surface;
+    if (wl_surface == surface) {
+        seat.pointer_x = wl_fixed_to_int(sx);
+        seat.pointer_y = wl_fixed_to_int(sy);
+    }
 }
 
 static void pointer_leave_handler(void *data,
@@ -445,7 +779,7 @@ static void pointer_leave_handler(void *data,
                                   uint32_t serial,
                                   struct wl_surface *surface)
 {
-    //
+    seat.pointer_surface = NULL;
 }
 
 static void pointer_motion_handler(void *data,
@@ -454,7 +788,12 @@ static void pointer_motion_handler(void *data,
                                    wl_fixed_t sx,
                                    wl_fixed_t sy)
 {
-    //
+    // The positioner anchor is in toplevel coordinates.
+    if (seat.pointer_surface != surface) {
+        return;
+    }
+    seat.pointer_x = wl_fixed_to_int(sx);
+    seat.pointer_y = wl_fixed_to_int(sy);
 }
 
 static void pointer_button_handler(void *data,
@@ -468,21 +807,17 @@ static void pointer_button_handler(void *data,
     seat.button_serial = serial;
 
     if (state & WL_POINTER_BUTTON_STATE_PRESSED) {
-        // Do not create popup if already created.
-        if (popup.wl_surface != NULL) {
-            destroy_popup(&popup);
-            return;
+        struct xdg_positioner *xdg_positioner = create_positioner();
+
+        if (popup.xdg_popup != NULL) {
+            // Move the open popup instead of closing and opening again.
+            popup.reposition_token += 1;
+            xdg_popup_reposition(popup.xdg_popup, xdg_positioner,
+                popup.reposition_token);
+        } else {
+            init_popup(&popup, xdg_positioner, serial);
         }
 
-        // Create positioner.
-        xdg_positioner = xdg_wm_base_create_positioner(xdg_wm_base);
-        xdg_positioner_set_size(xdg_positioner, 100, 50);
-        xdg_positioner_set_anchor_rect(xdg_positioner, 0, 0, 100, 50);
-
-        init_popup(&popup, serial);
-        wl_surface_commit(popup.wl_surface);
-
-        // Destroy positioner.
         xdg_positioner_destroy(xdg_positioner);
     }
 }
@@ -740,27 +1075,33 @@ static void get_server_references()
     }
 }
 
-static void init_popup(struct popup *popup, uint32_t serial)
+static struct xdg_positioner* create_positioner()
 {
-    // Create wl_surface.
-    popup->wl_surface = wl_compositor_create_surface(compositor);
-
-    // Create xdg_surface.
-    popup->xdg_surface = xdg_wm_base_get_xdg_surface(xdg_wm_base, popup->wl_surface);
-    xdg_surface_add_listener(popup->xdg_surface, &xdg_surface_listener, NULL);
-
-    // Create xdg_popup.
-    popup->xdg_popup = xdg_surface_get_popup(popup->xdg_surface, xdg_surface, xdg_positioner);
-    xdg_popup_add_listener(popup->xdg_popup, &xdg_popup_listener, NULL);
-
-    fprintf(stderr, "Grab serial: %d\n", seat.button_serial);
-    xdg_popup_grab(popup->xdg_popup, seat.wl_seat, seat.button_serial);
-
-    wl_surface_commit(popup->wl_surface);
+    struct xdg_positioner *xdg_positioner =
+        xdg_wm_base_create_positioner(xdg_wm_base);
+    xdg_positioner_set_size(xdg_positioner, POPUP_WIDTH, POPUP_HEIGHT);
+    xdg_positioner_set_anchor_rect(xdg_positioner,
+        seat.pointer_x, seat.pointer_y, 1, 1);
+    xdg_positioner_set_anchor(xdg_positioner,
+        XDG_POSITIONER_ANCHOR_BOTTOM_RIGHT);
+    xdg_positioner_set_gravity(xdg_positioner,
+        XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT);
+    // Let the compositor keep it on screen when moved.
+    xdg_positioner_set_constraint_adjustment(xdg_positioner,
+        XDG_POSITIONER_CONSTRAINT_ADJUSTMENT_FLIP_X |
+        XDG_POSITIONER_CONSTRAINT_ADJUSTMENT_FLIP_Y);
+
+    return xdg_positioner;
+}
 
-    wl_display_roundtrip(display);
+// Create the parts of a popup that survive closing it.
+static void create_popup_surface(struct popup *popup)
+{
+    popup->wl_surface = wl_compositor_create_surface(compositor);
 
-    popup->egl_window = wl_egl_window_create(popup->wl_surface, 100, 50);
+    popup->egl_window = wl_egl_window_create(popup->wl_surface,
+                                             POPUP_WIDTH,
+                                             POPUP_HEIGHT);
     popup->egl_surface = eglCreateWindowSurface(egl_display,
                                                 egl_conf,
                                                 popup->egl_window,
@@ -769,34 +1110,83 @@ static void init_popup(struct popup *popup, uint32_t serial)
         fprintf(stderr, " FAILED TO CREATE EGL WINDOW SURFACE!\n");
     }
 
-    eglMakeCurrent(egl_display, popup->egl_surface, popup->egl_surface, egl_context);
-
-    glClearColor(0.0, 0.0, 1.0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glFlush();
-
-    eglSwapBuffers(egl_display, popup->egl_surface);
+    popup->xdg_surface = NULL;
+    popup->xdg_popup = NULL;
+    popup->width = POPUP_WIDTH;
+    popup->height = POPUP_HEIGHT;
+    popup->reposition_token = 0;
 }
 
-static void destroy_popup(struct popup *popup)
+static void destroy_popup_surface(struct popup *popup)
 {
-    if (popup->egl_surface == NULL) {
-        return;
-    }
-
     eglDestroySurface(egl_display, popup->egl_surface);
     popup->egl_surface = NULL;
 
     wl_egl_window_destroy(popup->egl_window);
     popup->egl_window = NULL;
 
+    wl_surface_destroy(popup->wl_surface);
+    popup->wl_surface = NULL;
+}
+
+// Fill the pool ahead of time, so even the first popup opens fast.
+static void warm_popup_pool()
+{
+    while (popup_pool.length < POPUP_POOL_SIZE) {
+        create_popup_surface(&popup_pool.popups[popup_pool.length]);
+        popup_pool.length += 1;
+    }
+}
+
+static void init_popup(struct popup *popup,
+                       struct xdg_positioner *xdg_positioner,
+                       uint32_t serial)
+{
+    if (popup_pool.length > 0) {
+        popup_pool.length -= 1;
+        *popup = popup_pool.popups[popup_pool.length];
+    } else {
+        create_popup_surface(popup);
+    }
+
+    // Create xdg_surface.
+    popup->xdg_surface = xdg_wm_base_get_xdg_surface(xdg_wm_base, popup->wl_surface);
+    xdg_surface_add_listener(popup->xdg_surface,
+        &popup_xdg_surface_listener, popup);
+
+    // Create xdg_popup.
+    popup->xdg_popup = xdg_surface_get_popup(popup->xdg_surface, xdg_surface, xdg_positioner);
+    xdg_popup_add_listener(popup->xdg_popup, &xdg_popup_listener, popup);
+
+    fprintf(stderr, "Grab serial: %d\n", seat.button_serial);
+    xdg_popup_grab(popup->xdg_popup, seat.wl_seat, seat.button_serial);
+
+    // Drawn by the configure handler. No roundtrip.
+    wl_surface_commit(popup->wl_surface);
+}
+
+static void destroy_popup(struct popup *popup)
+{
+    if (popup->xdg_popup == NULL) {
+        return;
+    }
+
     xdg_popup_destroy(popup->xdg_popup);
     popup->xdg_popup = NULL;
 
     xdg_surface_destroy(popup->xdg_surface);
     popup->xdg_surface = NULL;
 
-    wl_surface_destroy(popup->wl_surface);
+    // A new xdg_surface needs a surface without a buffer.
+    wl_surface_attach(popup->wl_surface, NULL, 0, 0);
+    wl_surface_commit(popup->wl_surface);
+
+    if (popup_pool.length < POPUP_POOL_SIZE) {
+        popup_pool.popups[popup_pool.length] = *popup;
+        popup_pool.length += 1;
+    } else {
+        destroy_popup_surface(popup);
+    }
     popup->wl_surface = NULL;
 }
 
@@ -864,12 +1254,14 @@ int main(int argc, char *argv[])
     init_egl();
     create_window();
 
-    program_object = glCreateProgram();
+    init_program_cache();
     if (program_object == 0) {
-        fprintf(stderr, "glCreateProgram() - program_object is 0\n");
+        fprintf(stderr, "init_program_cache() - program_object is 0\n");
         return 0;
     }
 
+    warm_popup_pool();
+
     wl_surface_commit(surface);
 
     int res = wl_display_dispatch(display);
@@ -879,6 +1271,12 @@ int main(int argc, char *argv[])
     }
     fprintf(stderr, "wl_display_dispatch() - res: %d\n", res);
 
+    destroy_popup(&popup);
+    while (popup_pool.length > 0) {
+        popup_pool.length -= 1;
+        destroy_popup_surface(&popup_pool.popups[popup_pool.length]);
+    }
+
     wl_display_disconnect(display);
     printf("Disconnected from display.\n");
 